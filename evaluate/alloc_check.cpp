@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "rivercpp/HoeffdingTreeClassifier.tpp"
+#include "rivercpp/Pipeline.h"
+#include "rivercpp/PipelineClassifier.h"
+#include "rivercpp/StandardScaler.h"
+
+// Checks that learning and predicting do not allocate once a model has warmed up. Every
+// model first learns WARM_UP samples of a synthetic stream, one Gaussian blob per class,
+// and runs each call once so that buffers sized on first use are sized; the trees then
+// defer their split attempts, as growing a tree allocates its new leaves. Every call is
+// then made on MEASURED further samples while operator new counts, in its plain, array
+// and aligned forms; SlotPool takes its chunks from the aligned one.
+//
+//   ./alloc_check.out
+//
+// prints the allocations per model and exits with 1 if any model allocated.
+
+static size_t n_allocations = 0;
+
+// the nothrow forms call these, so they are counted as well
+void* operator new(std::size_t size) {
+    n_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+    n_allocations++;
+    // aligned_alloc wants a multiple of the alignment
+    std::size_t a = static_cast<std::size_t>(align);
+    if (void* p = std::aligned_alloc(a, (std::max<std::size_t>(size, 1) + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new[](std::size_t size, std::align_val_t align) { return operator new(size, align); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+constexpr int NUM_FEATURES = 8;
+constexpr int NUM_CLASSES = 3;
+constexpr int WARM_UP = 20000;
+constexpr int MEASURED = 5000;
+constexpr int BATCH_ROWS = 16;
+
+struct Stream {
+    std::vector<std::vector<double>> x;
+    std::vector<int> y;
+    // the last BATCH_ROWS samples, row-major, for the batch predictions
+    std::vector<double> batch;
+};
+
+Stream make_stream(unsigned seed) {
+    std::mt19937_64 rng(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_int_distribution<int> label(0, NUM_CLASSES - 1);
+    Stream stream;
+    for (int t=0;t<WARM_UP + MEASURED;t++) {
+        int y = label(rng);
+        std::vector<double> x(NUM_FEATURES);
+        for (int i=0;i<NUM_FEATURES;i++) x[i] = normal(rng) + (i % NUM_CLASSES == y ? 1.5 : 0.0);
+        stream.x.push_back(std::move(x));
+        stream.y.push_back(y);
+    }
+    for (int t=WARM_UP + MEASURED - BATCH_ROWS;t<WARM_UP + MEASURED;t++) {
+        stream.batch.insert(stream.batch.end(), stream.x[t].begin(), stream.x[t].end());
+    }
+    return stream;
+}
+
+// learns the warm-up part, calls step(x, y) once to size its buffers, freezes the
+// model and counts the allocations of step over the measured part
+template <class Learn, class Freeze, class Step>
+size_t count_allocations(const Stream& stream, Learn learn, Freeze freeze, Step step) {
+    for (int t=0;t<WARM_UP;t++) learn(stream.x[t], stream.y[t]);
+    step(stream.x[0], stream.y[0]);
+    freeze();
+    size_t before = n_allocations;
+    for (int t=WARM_UP;t<WARM_UP + MEASURED;t++) step(stream.x[t], stream.y[t]);
+    return n_allocations - before;
+}
+
+bool report(const char* model, size_t n) {
+    printf("%s,%zu\n", model, n);
+    return n == 0;
+}
+
+int main() {
+    Stream stream = make_stream(42);
+    std::array<double, NUM_CLASSES> proba;
+    std::vector<double> batch_proba(BATCH_ROWS * NUM_CLASSES);
+    bool ok = true;
+    printf("model,allocations\n");
+
+    {
+        rivercpp::StandardScaler<NUM_FEATURES> scaler{};
+        std::array<double, NUM_FEATURES> z;
+        ok &= report("StandardScaler", count_allocations(stream,
+            [&](const std::vector<double>& x, int y) { scaler.learn_one(x, y); },
+            [] {},
+            [&](const std::vector<double>& x, int y) {
+                scaler.learn_one(x, y);
+                scaler.transform_one(x, z);
+            }));
+    }
+    {
+        rivercpp::HoeffdingTreeClassifier<NUM_FEATURES, NUM_CLASSES> tree;
+        ok &= report("HoeffdingTreeClassifier", count_allocations(stream,
+            [&](const std::vector<double>& x, int y) { tree.learn_one(x, y); },
+            [&] { tree.set_defer_splits(true); },
+            [&](const std::vector<double>& x, int y) {
+                tree.predict_one(x);
+                tree.predict_proba_one(x, proba);
+                tree.predict_proba_many(stream.batch, batch_proba, BATCH_ROWS);
+                tree.learn_one(x, y);
+                tree.predict_learn_one(x, y);
+            }));
+    }
+    {
+        auto* tree = new rivercpp::HoeffdingTreeClassifier<NUM_FEATURES, NUM_CLASSES>();
+        rivercpp::PipelineClassifier pipeline(new rivercpp::StandardScaler<NUM_FEATURES>(), tree);
+        // called through the interface as ex_phishing.cpp does
+        rivercpp::Classifier* model = &pipeline;
+        ok &= report("PipelineClassifier", count_allocations(stream,
+            [&](const std::vector<double>& x, int y) { model->learn_one(x, y); },
+            [&] { tree->set_defer_splits(true); },
+            [&](const std::vector<double>& x, int y) {
+                model->predict_one(x);
+                model->predict_proba_one(x, proba);
+                model->predict_proba_many(stream.batch, batch_proba, BATCH_ROWS);
+                model->learn_one(x, y);
+                model->predict_learn_one(x, y);
+            }));
+    }
+    {
+        rivercpp::Pipeline<NUM_FEATURES, rivercpp::StandardScaler<NUM_FEATURES>,
+            rivercpp::HoeffdingTreeClassifier<NUM_FEATURES, NUM_CLASSES>> pipeline;
+        ok &= report("Pipeline", count_allocations(stream,
+            [&](const std::vector<double>& x, int y) { pipeline.learn_one(x, y); },
+            [&] { pipeline.model().set_defer_splits(true); },
+            [&](const std::vector<double>& x, int y) {
+                pipeline.predict_one(x);
+                pipeline.predict_proba_one(x, proba);
+                pipeline.learn_one(x, y);
+                pipeline.predict_learn_one(x, y);
+            }));
+    }
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "rivercpp/ARFClassifier.h"
+#include "rivercpp/AsyncTrainer.h"
+
+// Checks AsyncTrainer with HoeffdingTreeClassifier and ARFClassifier. A producer
+// submits a synthetic stream, one Gaussian blob per class, while READERS threads keep
+// predicting from the published snapshots. After flush() the trainer must have learned
+// every sample, published at least once per MAX_STALENESS of them, serve a snapshot
+// that predicts like the same model trained in the caller's thread, and once the
+// readers are gone free every snapshot but the served one.
+//
+//   ./async_check.out
+//
+// prints one CSV row per model and exits with 1 if a check failed.
+
+constexpr int NUM_FEATURES = 8;
+constexpr int NUM_CLASSES = 3;
+constexpr int N_SAMPLES = 20000;
+constexpr int N_TEST = 2000;
+constexpr size_t QUEUE_CAPACITY = 256;
+constexpr size_t MAX_STALENESS = 128;
+constexpr int READERS = 2;
+
+struct Stream {
+    std::vector<std::vector<double>> x;
+    std::vector<int> y;
+};
+
+Stream make_stream(unsigned seed, int n) {
+    std::mt19937_64 rng(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_int_distribution<int> label(0, NUM_CLASSES - 1);
+    Stream stream;
+    for (int t=0;t<n;t++) {
+        int y = label(rng);
+        std::vector<double> x(NUM_FEATURES);
+        for (int i=0;i<NUM_FEATURES;i++) x[i] = normal(rng) + (i % NUM_CLASSES == y ? 1.5 : 0.0);
+        stream.x.push_back(std::move(x));
+        stream.y.push_back(y);
+    }
+    return stream;
+}
+
+// model and reference start out identical and learn the same samples in the same order
+template <class Model>
+bool check(const char* name, Model* model, Model& reference, const Stream& train, const Stream& test) {
+    rivercpp::AsyncTrainer<NUM_FEATURES, Model> trainer(model, QUEUE_CAPACITY, MAX_STALENESS);
+    std::atomic<bool> done{false};
+    std::atomic<std::uint64_t> n_predictions{0};
+    std::atomic<bool> bad_proba{false};
+    std::vector<std::thread> readers;
+    for (int r=0;r<READERS;r++) {
+        readers.emplace_back([&, r] {
+            std::array<double, NUM_CLASSES> proba;
+            for (size_t t=r;!done.load(std::memory_order_relaxed);t++) {
+                std::span<const double> x(test.x[t % test.x.size()]);
+                trainer.predict_proba_one(x, proba);
+                double total = proba[0] + proba[1] + proba[2];
+                // an empty model predicts all zeros
+                if (total != 0.0 && std::abs(total - 1.0) > 1e-9) bad_proba = true;
+                trainer.predict_one(x);
+                n_predictions.fetch_add(2, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (int t=0;t<N_SAMPLES;t++) {
+        trainer.submit_wait(train.x[t], train.y[t]);
+        reference.learn_one(train.x[t], train.y[t]);
+    }
+    trainer.flush();
+    done = true;
+    for (std::thread& reader : readers) reader.join();
+
+    int n_disagree = 0;
+    for (int t=0;t<N_TEST;t++) {
+        n_disagree += trainer.predict_one(test.x[t]) != reference.predict_one(test.x[t]);
+    }
+    // the idle trainer frees what the readers held at the last publish
+    rivercpp::AsyncTrainerStats stats = trainer.stats();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (stats.reclaimed + 1 < stats.published && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        stats = trainer.stats();
+    }
+
+    bool ok = stats.submitted == N_SAMPLES && stats.rejected == 0 && stats.trained == N_SAMPLES
+        && stats.staleness == 0 && stats.queue_depth == 0
+        && stats.published >= 1 + N_SAMPLES / MAX_STALENESS
+        && stats.reclaimed + 1 == stats.published
+        && n_disagree == 0 && !bad_proba;
+    printf("%s,%llu,%llu,%llu,%llu,%llu,%d,%s\n", name,
+        static_cast<unsigned long long>(stats.trained), static_cast<unsigned long long>(stats.published),
+        static_cast<unsigned long long>(stats.reclaimed), static_cast<unsigned long long>(stats.waits),
+        static_cast<unsigned long long>(n_predictions.load()), n_disagree, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main() {
+    Stream train = make_stream(42, N_SAMPLES);
+    Stream test = make_stream(7, N_TEST);
+    bool ok = true;
+    printf("model,trained,published,reclaimed,waits,predictions,disagreements,result\n");
+    {
+        using Tree = rivercpp::HoeffdingTreeClassifier<NUM_FEATURES, NUM_CLASSES>;
+        Tree reference;
+        ok &= check("HoeffdingTreeClassifier", new Tree(), reference, train, test);
+    }
+    {
+        using Forest = rivercpp::ARFClassifier<NUM_FEATURES, NUM_CLASSES>;
+        Forest reference(5, 3, 42);
+        ok &= check("ARFClassifier", new Forest(5, 3, 42), reference, train, test);
+    }
+    return ok ? 0 : 1;
+}
\ No newline at end of file
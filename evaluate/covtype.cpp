@@ -4,7 +4,7 @@
 
 #include "rivercpp/io/CSVReader.h"
 #include "rivercpp/ARFClassifier.h"
-#include "rivercpp/PipelineClassifier.h"
+#include "rivercpp/Pipeline.h"
 #include "rivercpp/StandardScaler.h"
 #include "rivercpp/drift/DetectorConcept.h"
 #include "rivercpp/drift/DDM.h"
@@ -19,11 +19,12 @@ int main() {
     // DetectorFactory<ADWIN<5>, 0.01>, DetectorFactory<ADWIN<5>, 0.001>
     // DetectorFactory<DDM, 2.0>, DetectorFactory<DDM, 3.0>
     // DetectorFactory<HDDM_W, 0.005>, DetectorFactory<HDDM_W, 0.001>
-    rivercpp::Classifier* model = new rivercpp::PipelineClassifier(
-        new rivercpp::StandardScaler<NUM_FEATURES>(), 
-        new rivercpp::ARFClassifier<NUM_FEATURES, NUM_CLASSES, 
+    rivercpp::Pipeline<NUM_FEATURES, 
+        rivercpp::StandardScaler<NUM_FEATURES>, 
+        rivercpp::ARFClassifier<NUM_FEATURES, NUM_CLASSES, 
             rivercpp::DetectorFactory<rivercpp::DDM, 2.0>, 
-            rivercpp::DetectorFactory<rivercpp::DDM, 3.0> >(10, 5, 42) // (n_models, max_features, seed)
+            rivercpp::DetectorFactory<rivercpp::DDM, 3.0> > > model(
+        std::piecewise_construct, std::tuple(), std::tuple(10, 5, 42) // (n_models, max_features, seed)
     );
 
     rivercpp::Accuracy<NUM_CLASSES> metric;
@@ -31,9 +32,8 @@ int main() {
     auto begin = std::chrono::high_resolution_clock::now();
 
     while(reader.next()) {
-        int pred = model->predict_one(reader.features);
+        int pred = model.predict_learn_one(reader.features, reader.label-1);
         metric.update(reader.label-1, pred);
-        model->learn_one(reader.features, reader.label-1);
     }
 
     auto end = std::chrono::high_resolution_clock::now();
@@ -42,6 +42,5 @@ int main() {
     printf("Accuracy: %lf\n", metric.get());
     printf("Time measured: %lld ms.\n", static_cast<long long>(elapsed.count()));
 
-    delete model;
     return 0;
 }
\ No newline at end of file
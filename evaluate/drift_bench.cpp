@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "rivercpp/drift/DetectorConcept.h"
+#include "rivercpp/drift/ADWIN.h"
+#include "rivercpp/drift/DDM.h"
+#include "rivercpp/drift/HDDM_W.h"
+#include "rivercpp/drift/PageHinckley.h"
+
+// Cost and quality of the drift detectors on synthetic streams with one known change.
+// Every run feeds a stable segment and then a segment whose mean is higher, reached at
+// once (abrupt) or over a linear ramp (gradual); the detectors only look for increases.
+// A detection before the change is a false alarm, the first one from the start of the
+// change on gives the delay, a run without one misses the change. DDM and HDDM_W model
+// error indicators in [0, 1], which the Gaussian streams mostly but not always respect.
+//
+//   ./drift_bench.out [--json] [--runs N]
+//
+// prints one CSV row (or JSON object) per detector and stream, the mean delay is nan
+// (null) when no run detected the change.
+
+static size_t n_allocations = 0;
+static size_t allocated_bytes = 0;
+
+void* operator new(std::size_t size) {
+    n_allocations++;
+    allocated_bytes += size;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+constexpr int STABLE_LENGTH = 20000;
+constexpr int CHANGED_LENGTH = 10000;
+constexpr int RAMP_LENGTH = 2000;
+constexpr double MEAN_BEFORE = 0.2;
+constexpr double MEAN_AFTER = 0.4;
+constexpr double GAUSSIAN_SD = 0.1;
+
+struct StreamSpec {
+    const char* name;
+    bool gaussian;
+    bool gradual;
+};
+
+const StreamSpec STREAMS[] = {
+    {"bernoulli_abrupt", false, false},
+    {"bernoulli_gradual", false, true},
+    {"gaussian_abrupt", true, false},
+    {"gaussian_gradual", true, true},
+};
+
+std::vector<double> make_stream(const StreamSpec& spec, unsigned seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, GAUSSIAN_SD);
+    std::vector<double> values(STABLE_LENGTH + CHANGED_LENGTH);
+    for (int t=0;t<STABLE_LENGTH + CHANGED_LENGTH;t++) {
+        double progress = 0.0;
+        if (t >= STABLE_LENGTH) {
+            progress = spec.gradual ? std::min(1.0, (t - STABLE_LENGTH + 1) / double(RAMP_LENGTH)) : 1.0;
+        }
+        double mean = MEAN_BEFORE + progress * (MEAN_AFTER - MEAN_BEFORE);
+        values[t] = spec.gaussian ? mean + normal(rng) : double(uniform(rng) < mean);
+    }
+    return values;
+}
+
+struct Result {
+    std::string detector;
+    const char* stream;
+    int runs = 0;
+    double update_ns = 0.0;
+    size_t allocations = 0;
+    size_t heap_bytes = 0;
+    size_t bytes = 0;
+    size_t false_alarms = 0;
+    int detected = 0;
+    double delay_sum = 0.0;
+};
+
+template <rivercpp::IsDetectorFactory F>
+Result bench(const std::string& name, const StreamSpec& spec, int runs) {
+    Result result;
+    result.detector = name;
+    result.stream = spec.name;
+    result.runs = runs;
+    double total_ns = 0.0;
+    for (int run=0;run<runs;run++) {
+        std::vector<double> values = make_stream(spec, 1000 + run);
+        std::vector<char> drifts(values.size());
+        // construction counts towards the detector's allocations
+        size_t allocations = n_allocations;
+        size_t heap_bytes = allocated_bytes;
+        typename F::DetectorType detector = F::create();
+
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t t=0;t<values.size();t++) {
+            detector.update(values[t]);
+            drifts[t] = detector.drift_detected;
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        total_ns += std::chrono::duration<double, std::nano>(end - begin).count();
+        result.allocations += n_allocations - allocations;
+        result.heap_bytes += allocated_bytes - heap_bytes;
+        result.bytes = sizeof(detector);
+        for (int t=0;t<STABLE_LENGTH;t++) {
+            result.false_alarms += drifts[t];
+        }
+        for (size_t t=STABLE_LENGTH;t<values.size();t++) {
+            if (drifts[t]) {
+                result.detected++;
+                result.delay_sum += t - STABLE_LENGTH;
+                break;
+            }
+        }
+    }
+    result.update_ns = total_ns / (double(runs) * (STABLE_LENGTH + CHANGED_LENGTH));
+    return result;
+}
+
+int main(int argc, char** argv) {
+    bool json = false;
+    int runs = 20;
+    for (int i=1;i<argc;i++) {
+        if (std::strcmp(argv[i], "--json") == 0) json = true;
+        else if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc) runs = std::max(1, std::atoi(argv[++i]));
+    }
+
+    using namespace rivercpp;
+    std::vector<Result> results;
+    for (const StreamSpec& spec : STREAMS) {
+        results.push_back(bench<DetectorFactory<ADWIN<5>, 0.01>>("ADWIN(delta=0.01)", spec, runs));
+        results.push_back(bench<DetectorFactory<ADWIN<5>, 0.001>>("ADWIN(delta=0.001)", spec, runs));
+        results.push_back(bench<DetectorFactory<DDM, 2.0>>("DDM(threshold=2)", spec, runs));
+        results.push_back(bench<DetectorFactory<DDM, 3.0>>("DDM(threshold=3)", spec, runs));
+        results.push_back(bench<DetectorFactory<HDDM_W, 0.005>>("HDDM_W(confidence=0.005)", spec, runs));
+        results.push_back(bench<DetectorFactory<HDDM_W, 0.001>>("HDDM_W(confidence=0.001)", spec, runs));
+        results.push_back(bench<DetectorFactory<PageHinckley, 20.0>>("PageHinckley(threshold=20)", spec, runs));
+        results.push_back(bench<DetectorFactory<PageHinckley, 50.0>>("PageHinckley(threshold=50)", spec, runs));
+    }
+
+    if (json) printf("[\n");
+    else printf("detector,stream,runs,ns_per_update,allocations_per_run,heap_bytes_per_run,bytes,"
+        "false_alarms_per_10k,detection_rate,mean_delay\n");
+    for (size_t i=0;i<results.size();i++) {
+        const Result& r = results[i];
+        double false_alarm_rate = 1e4 * r.false_alarms / (double(r.runs) * STABLE_LENGTH);
+        double detection_rate = r.detected / double(r.runs);
+        double mean_delay = r.detected > 0 ? r.delay_sum / r.detected : std::nan("");
+        if (json) {
+            printf("  {\"detector\": \"%s\", \"stream\": \"%s\", \"runs\": %d, \"ns_per_update\": %.2f, "
+                "\"allocations_per_run\": %.1f, \"heap_bytes_per_run\": %.1f, \"bytes\": %zu, "
+                "\"false_alarms_per_10k\": %.3f, \"detection_rate\": %.3f, \"mean_delay\": ",
+                r.detector.c_str(), r.stream, r.runs, r.update_ns,
+                r.allocations / double(r.runs), r.heap_bytes / double(r.runs), r.bytes,
+                false_alarm_rate, detection_rate);
+            if (r.detected > 0) printf("%.1f}", mean_delay);
+            else printf("null}");
+            printf("%s\n", (i + 1 < results.size()) ? "," : "");
+        } else {
+            printf("%s,%s,%d,%.2f,%.1f,%.1f,%zu,%.3f,%.3f,%.1f\n",
+                r.detector.c_str(), r.stream, r.runs, r.update_ns,
+                r.allocations / double(r.runs), r.heap_bytes / double(r.runs), r.bytes,
+                false_alarm_rate, detection_rate, mean_delay);
+        }
+    }
+    if (json) printf("]\n");
+    return 0;
+}
\ No newline at end of file
@@ -5,7 +5,7 @@
 #include "rivercpp/io/CSVReader.h"
 #include "rivercpp/AMRules.h"
 #include "rivercpp/Metrics.h"
-#include "rivercpp/PipelineRegressor.h"
+#include "rivercpp/Pipeline.h"
 #include "rivercpp/StandardScaler.h"
 #include "rivercpp/drift/DetectorConcept.h"
 #include "rivercpp/drift/DDM.h"
@@ -16,19 +16,18 @@ int main() {
     std::string data_path = "../data/trump_approval.csv";
     rivercpp::CSVReader<double> reader(data_path);
 
-    rivercpp::Regressor* model = new rivercpp::PipelineRegressor(
-        new rivercpp::StandardScaler<NUM_FEATURES>(), 
-        new rivercpp::AMRules<NUM_FEATURES>()
-    );
+    rivercpp::Pipeline<NUM_FEATURES, 
+        rivercpp::StandardScaler<NUM_FEATURES>, 
+        rivercpp::AMRules<NUM_FEATURES> > model;
 
     rivercpp::MSE metric;
 
     auto begin = std::chrono::high_resolution_clock::now();
 
     while(reader.next()) {
-        double pred = model->predict_one(reader.features);
+        double pred = model.predict_one(reader.features);
         metric.update(reader.label, pred);
-        model->learn_one(reader.features, reader.label);
+        model.learn_one(reader.features, reader.label);
     }
 
     auto end = std::chrono::high_resolution_clock::now();
@@ -37,6 +36,5 @@ int main() {
     printf("MSE: %lf\n", metric.get());
     printf("Time measured: %lld ms.\n", static_cast<long long>(elapsed.count()));
 
-    delete model;
     return 0;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 # include <cmath>
 # include <concepts>
 # include <optional>
+# include <span>
 # include <vector>
 
 # include "drift/DetectorConcept.h"
@@ -23,7 +24,7 @@ public:
     int on;
     double at;
     NumericLiteral(int on, double at, bool neg=false) : neg(neg), on(on), at(at) {}
-    bool operator()(const std::vector<double>& x) const {
+    bool operator()(std::span<const double> x) const {
         assert((x.size() > static_cast<size_t>(on)) && "NumericLiteral(): Feature index out of bounds!");
         if (!neg) return x[on] <= at;
         else return x[on] > at;
@@ -34,10 +35,10 @@ class MeanRegressor : public Regressor {
 private:
     Mean mean;
 public:
-    virtual void learn_one(const std::vector<double>& x, double y) override {
+    virtual void learn_one(std::span<const double> x, double y) override {
         mean.update(y);
     }
-    virtual double predict_one(const std::vector<double>& x) override {
+    virtual double predict_one(std::span<const double> x) override {
         return mean.get();
     }
 };
@@ -52,7 +53,7 @@ private:
     double _mae_model = 0.0;
 public:
     AdaptiveRegressor(double fading_factor=0.99) : fading_factor(fading_factor) {}
-    virtual void learn_one(const std::vector<double>& x, double y) override {
+    virtual void learn_one(std::span<const double> x, double y) override {
         double abs_error_mean = std::fabs(y - mean_predictor.predict_one(x));
         double abs_error_model = std::fabs(y - model_predictor.predict_one(x));
         _mae_mean = fading_factor * _mae_mean + abs_error_mean;
@@ -60,7 +61,7 @@ public:
         mean_predictor.learn_one(x, y);
         model_predictor.learn_one(x, y);
     }
-    virtual double predict_one(const std::vector<double>& x) override {
+    virtual double predict_one(std::span<const double> x) override {
         if (_mae_mean <= _mae_model) return mean_predictor.predict_one(x);
         else return model_predictor.predict_one(x);
     }
@@ -80,11 +81,11 @@ protected:
 public:
     std::vector<NumericLiteral> literals;
     double total_weight = 0.0;
-    bool covers(const std::vector<double>& x) {
+    bool covers(std::span<const double> x) {
         return std::all_of(literals.begin(), literals.end(), 
             [&x](const NumericLiteral& lit) { return lit(x); });
     }
-    void update(const std::vector<double>& x, double y, double w) {
+    void update(std::span<const double> x, double y, double w) {
         total_weight += w;
         _update_target_stats(y, w);
         for (int i=0;i<num_features;i++) {
@@ -165,7 +166,7 @@ public:
         drift_detector.update(abs_error);
         return drift_detector.drift_detected;
     }
-    double score_one(const std::vector<double>& x) {
+    double score_one(std::span<const double> x) {
         double score = 0.0;
         int hits = 0;
         for (int i=0;i<num_features;i++) {
@@ -181,11 +182,11 @@ public:
         }
         return hits > 0 ? score / hits : 0.0;
     }
-    void learn_one(const std::vector<double>& x, double y) {
+    void learn_one(std::span<const double> x, double y) {
         this->update(x, y, 1.0);
         pred_model.learn_one(x, y);
     }
-    double predict_one(const std::vector<double>& x) {
+    double predict_one(std::span<const double> x) {
         return pred_model.predict_one(x);
     }
 };
@@ -203,7 +204,7 @@ private:
     }
 public:
     AMRules() {}
-    virtual void learn_one(const std::vector<double>& x, double y) {
+    virtual void learn_one(std::span<const double> x, double y) {
         bool any_covered = false;
         std::vector<int> to_del;
         for (size_t i=0;i<_rules.size();i++) {
@@ -249,7 +250,7 @@ public:
             _rules.erase(_rules.begin() + *it);
         }
     }
-    virtual double predict_one(const std::vector<double>& x) {
+    virtual double predict_one(std::span<const double> x) {
         for (auto& rule : _rules) {
             if (rule.covers(x)) return rule.predict_one(x);
         }
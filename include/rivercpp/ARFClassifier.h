@@ -5,39 +5,71 @@
 # include <vector>
 # include <cmath>
 # include <random>
+# include <array>
+# include <atomic>
+# include <memory>
+# include <numeric>
+# include <thread>
 
 # include "drift/DetectorConcept.h"
+# include "BoundedQueue.h"
 # include "Classifier.h"
+# include "CounterRNG.h"
 # include "HoeffdingTreeClassifier.tpp"
+# include "LatencyBudget.h"
 # include "Metrics.h"
 # include "utils.h"
 # include "drift/ADWIN.h"
 
 namespace rivercpp {
 template <int num_features, int num_labels>
-class BaseTreeClassifier : public HoeffdingTreeClassifier<num_features, num_labels> {
+class BaseTreeClassifier final : public HoeffdingTreeClassifier<num_features, num_labels> {
 protected:
-    std::default_random_engine* rng;
+    // owned by the tree, so trees of one forest can learn on different threads
+    CounterRNG rng;
     int max_features;
 public:
-    BaseTreeClassifier(std::default_random_engine* rng=nullptr, int max_features=2, int grace_period = 200, 
+    BaseTreeClassifier(CounterRNG rng=CounterRNG(), int max_features=2, int grace_period = 200, 
         double delta = 1e-7, double tau = 0.05,
         double max_share_to_split = 0.99, 
         double min_branch_fraction = 0.01) : 
         HoeffdingTreeClassifier<num_features, num_labels>(grace_period, delta, tau, max_share_to_split, min_branch_fraction),
-        rng(rng), max_features(max_features) {}   
-    virtual BranchOrLeaf<num_features, num_labels>* _new_leaf(LeafNaiveBayesAdaptive<num_features, num_labels>* parent=nullptr) {
+        rng(rng), max_features(max_features) {
+        this->_set_leaf_features(std::min(max_features, num_features));
+    }
+    // empty tree drawing from rng, storage of the old tree is reused
+    void reset(CounterRNG rng) {
+        HoeffdingTreeClassifier<num_features, num_labels>::reset();
+        this->rng = rng;
+    }
+    virtual LeafNaiveBayesAdaptive<num_features, num_labels>* _new_leaf(LeafNaiveBayesAdaptive<num_features, num_labels>* parent=nullptr) {
         int depth;
         if (parent == nullptr) {
             depth = 0;
         } else {
             depth = parent->depth + 1;
         }
-        return new RandomLeafNaiveBayesAdaptive<num_features, num_labels>(depth, max_features, rng);
+        std::array<int, num_features> feature_indices;
+        int n_feature_indices = RandomLeafNaiveBayesAdaptive<num_features, num_labels>::sample_features(
+            feature_indices, max_features, rng);
+        return this->_nodes.template create_leaf<RandomLeafNaiveBayesAdaptive<num_features, num_labels>>(
+            depth, &this->_splitter_pool, &this->_nb_pool, feature_indices, n_feature_indices);
     } 
     virtual ~BaseTreeClassifier() = default;
 };
 
+struct ARFLatencyStats {
+    double learn_ns = 0.0;                    // smoothed cost of a learn_one call
+    double predict_ns = 0.0;                  // smoothed cost of a prediction
+    double learn_level = 0.0;                 // shed levels in [0, 1]
+    double predict_level = 0.0;
+    std::uint64_t learn_over_budget = 0;      // calls that took longer than their target
+    std::uint64_t predict_over_budget = 0;
+    std::uint64_t trainings_shed = 0;         // tree updates dropped by thinning
+    std::uint64_t split_attempts_deferred = 0;
+    std::uint64_t trees_shed = 0;             // tree evaluations skipped by predictions
+};
+
 // max features is always sqrt
 // warning_detection & drift_detection always on
 template <int num_features, int num_labels, 
@@ -45,14 +77,77 @@ template <int num_features, int num_labels,
     IsDetectorFactory DriftDetectorFactory=DetectorFactory<ADWIN<5>, 0.001> >
 class ARFClassifier : public Classifier {
 protected:
-    std::vector<Classifier*> models;
-    std::vector<BaseTreeClassifier<num_features, num_labels>*> _background;
+    using Tree = BaseTreeClassifier<num_features, num_labels>;
+    // 2 * n_models trees built once in one block: every slot owns a foreground tree and a
+    // spare, the spare serves as its background tree and the two swap on promotion.
+    // A replaced tree is reset in place, so drift never allocates a tree
+    Tree* _trees = nullptr;
+    // foreground trees, empty until the ensemble is initialised
+    std::vector<Tree*> models;
+    std::vector<Tree*> _spares;
+    // _spares[i] while slot i trains a background tree, nullptr otherwise
+    std::vector<Tree*> _background;
     std::vector<typename DriftDetectorFactory::DetectorType> _drift_detectors;
     std::vector<typename WarningDetectorFactory::DetectorType> _warning_detectors;
     std::vector<Accuracy<num_labels> > _metrics;
     std::vector<int> _drift_tracker;
     std::vector<int> _warning_tracker;
-    std::default_random_engine* _rng;
+    std::vector<double> _batch_proba;
+    // one num_labels row per tree and the weight of its vote, filled by predict_proba_one
+    // and by learn_one, which records every tree's vote before it learned
+    std::vector<double> _tree_proba;
+    std::vector<double> _tree_weights;
+    // early-exit voting: trees heaviest vote first, kept sorted across calls since the
+    // weights drift slowly, and the number of trees the last predict_one evaluated
+    bool _early_exit_voting = false;
+    std::vector<int> _vote_order;
+    int _trees_evaluated = 0;
+    // latency budgets of learn_one and of predictions, see set_latency_budget. Learning
+    // keeps a tree's sample with probability _train_keep and defers split attempts past
+    // half load, predictions use the heaviest trees only
+    LatencyBudget _learn_budget;
+    LatencyBudget _predict_budget;
+    double _train_keep = 1.0;
+    bool _splits_deferred = false;
+    // per slot, so slots learning in parallel never share a counter
+    std::vector<std::uint64_t> _trainings_shed;
+    std::uint64_t _trees_shed = 0;
+    // every slot draws from its own streams: the poisson weights from generation 0 and
+    // each tree that ever held the slot from the next generation, see slot_stream. A tree's
+    // stream picks the feature subset of every leaf it grows, so for one seed the trees
+    // see the same features whichever thread trains them
+    std::uint64_t _seed;
+    std::vector<CounterRNG> _slot_rngs;
+    std::vector<std::uint32_t> _slot_generations;
+    // not owned, learn_one spreads the slots over it from _parallel_min_models trees on,
+    // predict_proba_one the trees from _parallel_predict_min_models on
+    ThreadPool* _thread_pool = nullptr;
+    int _parallel_min_models = 4;
+    int _parallel_predict_min_models = 16;
+    // with the background worker on, background trees learn from per-slot queues on their
+    // own thread; a slot waits for its queue to drain before it replaces or promotes its
+    // background tree, so the forest is the same as when they learn inline
+    struct BackgroundSample {
+        std::array<double, num_features> x;
+        int y;
+        int k;
+    };
+    struct BackgroundSlot {
+        BoundedQueue<BackgroundSample> queue;
+        // enqueued is only written by the thread learning the slot, trained by the worker,
+        // which notifies every increment so that waits on it sleep instead of spinning
+        std::atomic<std::uint64_t> enqueued{0};
+        std::atomic<std::uint64_t> trained{0};
+        // the background tree as last published by whoever trained it, read by the
+        // const observers so that they never wait for the worker
+        std::atomic<size_t> tree_bytes{0};
+        std::atomic<std::uint64_t> tree_deferred_splits{0};
+        explicit BackgroundSlot(size_t capacity) : queue(capacity) {}
+    };
+    std::vector<std::unique_ptr<BackgroundSlot>> _background_slots;
+    std::thread _background_worker;
+    std::atomic<bool> _background_stop{false};
+    std::atomic<std::uint64_t> _background_wake{0};
     int n_models;
     int max_features;
     int seed;
@@ -63,21 +158,318 @@ protected:
     double max_share_to_split;
     double min_branch_fraction;
     
+    // tree becomes the next tree to hold slot
+    void _reset_tree(Tree* tree, int slot) {
+        tree->reset(CounterRNG(_seed, slot_stream(slot, ++_slot_generations[slot])));
+    }
     void _init_ensemble() {
-        for (Classifier* model : models) {
-            if (model != nullptr)
-                delete model;
-        }
-        models.clear();
-        models.reserve(n_models);
+        models.resize(n_models);
+        _spares.resize(n_models);
         for (int i = 0; i < n_models; i++) {
-            models.push_back(new BaseTreeClassifier<num_features, num_labels>
-                (_rng, max_features, grace_period, delta, tau, max_share_to_split, min_branch_fraction));
+            models[i] = &_trees[i];
+            _spares[i] = &_trees[n_models + i];
+            _reset_tree(models[i], i);
+        }
+    }
+    void _background_loop() {
+        BackgroundSample sample;
+        std::vector<double> x(num_features);
+        while (true) {
+            bool worked = false;
+            for (int i=0;i<n_models;i++) {
+                BackgroundSlot& slot = *_background_slots[i];
+                while (slot.queue.try_pop(sample)) {
+                    std::copy(sample.x.begin(), sample.x.end(), x.begin());
+                    _background[i]->learn_one(x, sample.y, sample.k);
+                    _publish_background(i);
+                    slot.trained.fetch_add(1, std::memory_order_release);
+                    slot.trained.notify_all();
+                    worked = true;
+                }
+            }
+            if (worked) continue;
+            // the queues are drained before shutting down
+            std::uint64_t seen = _background_wake.load(std::memory_order_acquire);
+            bool pending = false;
+            for (int i=0;i<n_models;i++) {
+                pending = pending || _background_slots[i]->queue.size_approx() > 0;
+            }
+            if (pending) continue;
+            if (_background_stop.load(std::memory_order_acquire)) break;
+            _background_wake.wait(seen, std::memory_order_acquire);
+        }
+    }
+    void _learn_background(int i, std::span<const double> x, int y, int k) {
+        if (_background_slots.empty()) {
+            _background[i]->learn_one(x, y, k);
+            return;
+        }
+        BackgroundSlot& slot = *_background_slots[i];
+        BackgroundSample sample;
+        std::copy_n(x.begin(), num_features, sample.x.begin());
+        sample.y = y;
+        sample.k = k;
+        slot.enqueued.fetch_add(1, std::memory_order_relaxed);
+        while (true) {
+            // a full queue frees a cell before the worker counts the sample it took
+            std::uint64_t trained = slot.trained.load(std::memory_order_acquire);
+            if (slot.queue.try_push(sample)) break;
+            slot.trained.wait(trained, std::memory_order_acquire);
+        }
+        _background_wake.fetch_add(1, std::memory_order_release);
+        _background_wake.notify_one();
+    }
+    // after this the worker no longer touches _background[i] until the slot queues again
+    void _wait_background(int i) const {
+        if (_background_slots.empty()) return;
+        const BackgroundSlot& slot = *_background_slots[i];
+        std::uint64_t enqueued = slot.enqueued.load(std::memory_order_relaxed);
+        for (std::uint64_t trained = slot.trained.load(std::memory_order_acquire);trained < enqueued;
+            trained = slot.trained.load(std::memory_order_acquire)) {
+            slot.trained.wait(trained, std::memory_order_acquire);
+        }
+    }
+    // called by whichever thread may touch _background[i] at the time
+    void _publish_background(int i) {
+        if (_background_slots.empty()) return;
+        BackgroundSlot& slot = *_background_slots[i];
+        slot.tree_bytes.store(_background[i]->memory_usage(), std::memory_order_relaxed);
+        slot.tree_deferred_splits.store(_background[i]->deferred_split_attempts(), std::memory_order_relaxed);
+    }
+    // sums get over every tree without waiting for the worker: a background tree it may be
+    // training counts with the value last published to its slot
+    template <class T>
+    T _sum_trees(T (Tree::*get)() const, std::atomic<T> BackgroundSlot::*published) const {
+        T total = 0;
+        if (models.empty()) {
+            for (int i=0;i<2 * n_models;i++) total += (_trees[i].*get)();
+            return total;
+        }
+        for (int i=0;i<n_models;i++) {
+            total += (models[i]->*get)();
+            if (!_background_slots.empty() && _background[i] != nullptr) {
+                total += ((*_background_slots[i]).*published).load(std::memory_order_relaxed);
+            } else {
+                total += (_spares[i]->*get)();
+            }
+        }
+        return total;
+    }
+    // everything a sample does to one slot, touches no state of any other slot. The tree
+    // finds its leaf once for both its vote and its update
+    void _learn_slot(int i, std::span<const double> x, int y) {
+        Tree* model = models[i];
+        std::span<double> proba = std::span<double>(_tree_proba).subspan(i * num_labels, num_labels);
+        _tree_weights[i] = _metrics[i].get();
+        int k = poisson(lambda_value, _slot_rngs[i]);
+        // a thinned Poisson(lambda) weight is a Poisson(lambda * keep) one
+        if (k > 0 && _train_keep < 1.0
+            && std::uniform_real_distribution<double>(0.0, 1.0)(_slot_rngs[i]) >= _train_keep) {
+            k = 0;
+            _trainings_shed[i]++;
+        }
+        int y_pred;
+        if (k > 0) {
+            y_pred = model->predict_learn_one(x, y, k, proba);
+        } else {
+            model->predict_proba_one(x, proba);
+            y_pred = std::distance(proba.begin(), std::max_element(proba.begin(), proba.end()));
+        }
+        _metrics[i].update(y, y_pred);
+        if (k > 0) {
+            if (_background[i] != nullptr) {
+                _learn_background(i, x, y, k);
+            }
+
+            int drift_input = _drift_detector_input(y, y_pred);
+            _warning_detectors[i].update(drift_input);
+            if (_warning_detectors[i].drift_detected) {
+                _wait_background(i);
+                _reset_tree(_spares[i], i);
+                _background[i] = _spares[i];
+                _publish_background(i);
+                _warning_detectors[i] = WarningDetectorFactory::create();
+                _warning_tracker[i]++;
+            }
+
+            _drift_detectors[i].update(drift_input);
+            if (_drift_detectors[i].drift_detected) {
+                if (_background[i] != nullptr) {
+                    _wait_background(i);
+                    std::swap(models[i], _spares[i]);
+                    // the old foreground tree drops its nodes until the slot needs it again
+                    _spares[i]->reset(CounterRNG());
+                    _background[i] = nullptr;
+                    _warning_detectors[i] = WarningDetectorFactory::create();
+                    _drift_detectors[i] = DriftDetectorFactory::create();
+                    _metrics[i] = Accuracy<num_labels>();
+                } else {
+                    _reset_tree(models[i], i);
+                    _drift_detectors[i] = DriftDetectorFactory::create();
+                    _metrics[i] = Accuracy<num_labels>();
+                }
+                _drift_tracker[i]++;
+            }
         }
     }
     inline int _drift_detector_input(int y_true, int y_pred) {
         return (y_true == y_pred) ? 0 : 1;
     }
+    // a leaf whose naive Bayes densities all underflow votes NaN for every class; such a
+    // tree abstains rather than turning the whole ensemble's vote into NaN
+    static bool _abstains(const double* y_proba) {
+        return std::isnan(y_proba[0]);
+    }
+    // weighted sum of the rows in _tree_proba in tree order, normalised into proba
+    void _combine_votes(std::span<double> proba) const {
+        std::fill(proba.begin(), proba.end(), 0.0);
+        for (int i=0;i<n_models;i++) {
+            const double* y_proba_temp = &_tree_proba[i * num_labels];
+            if (_abstains(y_proba_temp)) continue;
+            double metric_value = _tree_weights[i];
+            for (int j=0;j<num_labels;j++) {
+                proba[j] += (metric_value > 0.0) ? y_proba_temp[j] * metric_value : y_proba_temp[j];
+            }
+        }
+        double total = std::accumulate(proba.begin(), proba.end(), 0.0);
+        for (int i=0;i<num_labels;i++) {
+            if (total > 0.0) {
+                proba[i] /= total;
+            } else {
+                proba[i] = 0.0;
+            }
+        }
+    }
+    static double _vote_weight(double metric_value) {
+        return (metric_value > 0.0) ? metric_value : 1.0;
+    }
+    // takes the current weights and orders the trees heaviest vote first, insertion sort
+    // since the order barely changes between calls; returns the total vote weight
+    double _sort_vote_order() {
+        double total = 0.0;
+        for (int i=0;i<n_models;i++) {
+            _tree_weights[i] = _metrics[i].get();
+            total += _vote_weight(_tree_weights[i]);
+        }
+        for (int i=1;i<n_models;i++) {
+            int tree = _vote_order[i];
+            int j = i;
+            for (;j>0 && _vote_weight(_tree_weights[_vote_order[j - 1]]) < _vote_weight(_tree_weights[tree]);j--) {
+                _vote_order[j] = _vote_order[j - 1];
+            }
+            _vote_order[j] = tree;
+        }
+        return total;
+    }
+    // trees a prediction may evaluate under the current predict budget
+    int _predicted_trees() const {
+        if (!_predict_budget.enabled()) return n_models;
+        return std::max(1, static_cast<int>(std::ceil(n_models * (1.0 - _predict_budget.level()))));
+    }
+    // weighted vote of the n_trees heaviest trees, normalised into proba
+    void _predict_top_trees(std::span<const double> x, std::span<double> proba, int n_trees) {
+        _sort_vote_order();
+        std::fill(proba.begin(), proba.end(), 0.0);
+        for (int n=0;n<n_trees;n++) {
+            int tree = _vote_order[n];
+            double* y_proba_temp = &_tree_proba[tree * num_labels];
+            models[tree]->predict_proba_one(x, std::span<double>(y_proba_temp, num_labels));
+            if (_abstains(y_proba_temp)) continue;
+            double weight = _vote_weight(_tree_weights[tree]);
+            for (int j=0;j<num_labels;j++) {
+                proba[j] += y_proba_temp[j] * weight;
+            }
+        }
+        double total = std::accumulate(proba.begin(), proba.end(), 0.0);
+        for (int i=0;i<num_labels;i++) {
+            proba[i] = (total > 0.0) ? proba[i] / total : 0.0;
+        }
+        _trees_evaluated = n_trees;
+        _trees_shed += n_models - n_trees;
+    }
+    void _apply_learn_budget() {
+        if (!_learn_budget.enabled()) return;
+        double level = _learn_budget.level();
+        // every tree keeps learning from some samples
+        _train_keep = std::max(0.1, 1.0 - level);
+        bool defer = level > 0.5;
+        if (defer != _splits_deferred) {
+            _splits_deferred = defer;
+            // background trees may be learning on the worker
+            for (int i=0;i<n_models;i++) _wait_background(i);
+            for (int i=0;i<2 * n_models;i++) {
+                _trees[i].set_defer_splits(defer);
+            }
+        }
+    }
+    // A tree adds at most its weight to any class, so once the leading class is ahead of
+    // the runner-up by more than the weight still to come the argmax is settled. A vote
+    // that is never settled early is combined in tree order like predict_proba_one, so
+    // the answer is always the one predict_proba_one gives.
+    int _predict_one_early_exit(std::span<const double> x) {
+        double remaining = _sort_vote_order();
+        // summing in another order than predict_proba_one may move the lead by a few ulps
+        double margin = 1e-9 * remaining;
+        std::array<double, num_labels> votes{};
+        for (int n=0;n<n_models;n++) {
+            int tree = _vote_order[n];
+            std::span<double> row = std::span<double>(_tree_proba).subspan(tree * num_labels, num_labels);
+            models[tree]->predict_proba_one(x, row);
+            double weight = _vote_weight(_tree_weights[tree]);
+            remaining -= weight;
+            if (_abstains(row.data())) continue;
+            int best = 0;
+            for (int j=0;j<num_labels;j++) {
+                votes[j] += row[j] * weight;
+                if (votes[j] > votes[best]) best = j;
+            }
+            double runner_up = 0.0;
+            for (int j=0;j<num_labels;j++) {
+                if (j != best) runner_up = std::max(runner_up, votes[j]);
+            }
+            if (votes[best] - runner_up > remaining + margin) {
+                _trees_evaluated = n + 1;
+                return best;
+            }
+        }
+        _trees_evaluated = n_models;
+        std::array<double, num_labels> proba;
+        _combine_votes(proba);
+        return std::distance(proba.begin(), std::max_element(proba.begin(), proba.end()));
+    }
+    // the budget chooses between every tree and the heaviest ones
+    void _predict_proba(std::span<const double> x, std::span<double> proba) {
+        std::fill(proba.begin(), proba.end(), 0.0);
+        _trees_evaluated = n_models;
+        if (models.size() == 0) {
+            _init_ensemble();
+        } else if (int n_trees = _predicted_trees(); n_trees < n_models) {
+            _predict_top_trees(x, proba, n_trees);
+        } else {
+            // every tree votes into its own row, possibly on the pool, and the rows are
+            // combined in tree order so both paths give the same bits
+            auto predict_tree = [&](size_t i) {
+                models[i]->predict_proba_one(
+                    x, std::span<double>(_tree_proba).subspan(i * num_labels, num_labels));
+                _tree_weights[i] = _metrics[i].get();
+            };
+            if (_thread_pool != nullptr && n_models >= _parallel_predict_min_models) {
+                _thread_pool->parallel_for(n_models, predict_tree);
+            } else {
+                for (int i=0;i<n_models;i++) predict_tree(i);
+            }
+            _combine_votes(proba);
+        }
+    }
+    void _learn_slots(std::span<const double> x, int y) {
+        if (_thread_pool != nullptr && n_models >= _parallel_min_models) {
+            _thread_pool->parallel_for(n_models, [&](size_t i) { _learn_slot(i, x, y); });
+        } else {
+            for (int i=0;i<n_models;i++) {
+                _learn_slot(i, x, y);
+            }
+        }
+    }
 public:
     ARFClassifier(int n_models=10, int max_features=(int)(std::sqrt(num_features)),  
         int seed=-1, int grace_period=50, int lambda_value=6, 
@@ -86,13 +478,19 @@ public:
         : n_models(n_models), max_features(max_features), seed(seed), 
         grace_period(grace_period), lambda_value(lambda_value), delta(delta), tau(tau), 
         max_share_to_split(max_share_to_split), min_branch_fraction(min_branch_fraction) {
-        if (seed != -1) {
-            _rng = new std::default_random_engine(seed);
-        } else {
-            _rng = new std::default_random_engine(std::random_device()());
+        _seed = (seed != -1) ? seed : std::random_device()();
+        _slot_generations = std::vector<std::uint32_t>(n_models, 0);
+        _slot_rngs.reserve(n_models);
+        for (int i=0;i<n_models;i++) {
+            _slot_rngs.push_back(CounterRNG(_seed, slot_stream(i, 0)));
         }
         _metrics = std::vector<Accuracy<num_labels> >(n_models);
-        _background = std::vector<BaseTreeClassifier<num_features, num_labels>*>(n_models, nullptr);
+        _trees = std::allocator<Tree>().allocate(2 * n_models);
+        for (int i=0;i<2 * n_models;i++) {
+            std::construct_at(_trees + i, CounterRNG(), max_features, grace_period, delta, tau, 
+                max_share_to_split, min_branch_fraction);
+        }
+        _background = std::vector<Tree*>(n_models, nullptr);
         _drift_detectors = std::vector<typename DriftDetectorFactory::DetectorType>(n_models);
         _warning_detectors = std::vector<typename WarningDetectorFactory::DetectorType>(n_models);
         for (int i=0;i<n_models;i++) {
@@ -101,95 +499,181 @@ public:
         }
         _drift_tracker = std::vector<int>(n_models, 0);
         _warning_tracker = std::vector<int>(n_models, 0);
+        _tree_proba = std::vector<double>(n_models * num_labels, 0.0);
+        _tree_weights = std::vector<double>(n_models, 0.0);
+        _trainings_shed = std::vector<std::uint64_t>(n_models, 0);
+        _vote_order = std::vector<int>(n_models);
+        std::iota(_vote_order.begin(), _vote_order.end(), 0);
     }
+    ARFClassifier(const ARFClassifier&) = delete;
+    ARFClassifier& operator=(const ARFClassifier&) = delete;
     ~ARFClassifier() {
-        for (Classifier* model : models) {
-            if (model != nullptr)
-                delete model;
+        disable_background_worker();
+        for (int i=0;i<2 * n_models;i++) {
+            std::destroy_at(_trees + i);
         }
-        for (BaseTreeClassifier<num_features, num_labels>* model : _background) {
-            if (model != nullptr)
-                delete model;
+        std::allocator<Tree>().deallocate(_trees, 2 * n_models);
+    }
+    // with a pool, slots learn concurrently; every slot only touches its own state and
+    // streams, so a fixed seed gives the same forest for any number of threads.
+    // Prediction only pays off on larger forests and has its own threshold.
+    void set_thread_pool(ThreadPool* pool, int min_models = 4, int min_predict_models = 16) {
+        _thread_pool = pool;
+        _parallel_min_models = min_models;
+        _parallel_predict_min_models = min_predict_models;
+    }
+    // moves background-tree training onto its own thread, so a slot under warning costs
+    // its foreground tree about the same as one without. Not to be called while learning.
+    void enable_background_worker(size_t queue_capacity = 1024) {
+        if (!_background_slots.empty()) return;
+        _background_slots.reserve(n_models);
+        for (int i=0;i<n_models;i++) {
+            _background_slots.push_back(std::make_unique<BackgroundSlot>(queue_capacity));
+            if (_background[i] != nullptr) _publish_background(i);
         }
-        if (_rng != nullptr) {
-            delete _rng;
+        _background_stop.store(false, std::memory_order_relaxed);
+        _background_worker = std::thread([this] { _background_loop(); });
+    }
+    // trains whatever is still queued, then goes back to learning background trees inline
+    void disable_background_worker() {
+        if (_background_slots.empty()) return;
+        _background_stop.store(true, std::memory_order_release);
+        _background_wake.fetch_add(1, std::memory_order_release);
+        _background_wake.notify_one();
+        _background_worker.join();
+        _background_slots.clear();
+    }
+    bool background_worker_enabled() const { return !_background_slots.empty(); }
+    using Classifier::predict_proba_one;
+    int num_classes() const override { return num_labels; }
+    void learn_one(std::span<const double> x, int y, double w=1.0) override {
+        LatencyBudget::Scope timed(_learn_budget);
+        if (models.size() == 0) {
+            _init_ensemble();
         }
+        _apply_learn_budget();
+        _learn_slots(x, y);
     }
-    void learn_one(const std::vector<double>& x, int y, double w=1.0) {
+    // the ensemble's prediction for x before learning from it, every tree is traversed once
+    int predict_learn_one(std::span<const double> x, int y, double w=1.0) override {
+        LatencyBudget::Scope timed(_learn_budget);
+        std::array<double, num_labels> proba{};
         if (models.size() == 0) {
             _init_ensemble();
+            // a fresh ensemble predicts nothing
+            _learn_slots(x, y);
+            return 0;
         }
-        for (int i=0;i<n_models;i++) {
-            Classifier* model = models[i];
-            int y_pred = model->predict_one(x);
-            _metrics[i].update(y, y_pred);
-            int k = poisson(lambda_value, _rng);
-            if (k > 0) {
-                if (_background[i] != nullptr) {
-                    _background[i]->learn_one(x, y, k);
-                }
-                model->learn_one(x, y, k);
-
-                int drift_input = _drift_detector_input(y, y_pred);
-                _warning_detectors[i].update(drift_input);
-                if (_warning_detectors[i].drift_detected) {
-                    if (_background[i]) {
-                        delete _background[i];
-                    }
-                    _background[i] = new BaseTreeClassifier<num_features, num_labels>
-                        (_rng, max_features, grace_period, delta, tau, max_share_to_split, min_branch_fraction);
-                    _warning_detectors[i] = WarningDetectorFactory::create();
-                    _warning_tracker[i]++;
-                }
+        _apply_learn_budget();
+        _learn_slots(x, y);
+        _combine_votes(proba);
+        return std::distance(proba.begin(), std::max_element(proba.begin(), proba.end()));
+    }
+    // live bytes of the ensemble: every foreground, background and idle spare tree plus the
+    // per-model bookkeeping, O(n_models) since each tree keeps its own counters. A tree
+    // training on the background worker counts as of the last sample it finished
+    size_t memory_usage() const {
+        size_t total = sizeof(*this) + (models.capacity() + _spares.capacity() + _background.capacity()) * sizeof(Tree*)
+            + _drift_detectors.capacity() * sizeof(typename DriftDetectorFactory::DetectorType)
+            + _warning_detectors.capacity() * sizeof(typename WarningDetectorFactory::DetectorType)
+            + _metrics.capacity() * sizeof(Accuracy<num_labels>) 
+            + (_drift_tracker.capacity() + _warning_tracker.capacity()) * sizeof(int)
+            + (_batch_proba.capacity() + _tree_proba.capacity() + _tree_weights.capacity()) * sizeof(double);
+        for (const std::unique_ptr<BackgroundSlot>& slot : _background_slots) {
+            total += sizeof(BackgroundSlot) + slot->queue.capacity() * (sizeof(BackgroundSample) + sizeof(std::atomic<size_t>));
+        }
+        return total + _sum_trees<size_t>(&Tree::memory_usage, &BackgroundSlot::tree_bytes);
+    }
 
-                _drift_detectors[i].update(drift_input);
-                if (_drift_detectors[i].drift_detected) {
-                    if (_background[i] != nullptr) {
-                        if (models[i]) {
-                            delete models[i];
-                        }
-                        models[i] = _background[i];
-                        _background[i] = nullptr;
-                        _warning_detectors[i] = WarningDetectorFactory::create();
-                        _drift_detectors[i] = DriftDetectorFactory::create();
-                        _metrics[i] = Accuracy<num_labels>();
-                    } else {
-                        if (models[i]) {
-                            delete models[i];
-                        }
-                        models[i] = new BaseTreeClassifier<num_features, num_labels>
-                            (_rng, max_features, grace_period, delta, tau, max_share_to_split, min_branch_fraction);
-                        _drift_detectors[i] = DriftDetectorFactory::create();
-                        _metrics[i] = Accuracy<num_labels>();
-                    }
-                    _drift_tracker[i]++;
-                }
+    // read-only copy of the current ensemble and its weights, safe to share between threads
+    FrozenForest<num_features, num_labels> freeze() const {
+        FrozenForest<num_features, num_labels> frozen;
+        for (size_t i=0;i<models.size();i++) {
+            frozen.add_tree(models[i]->freeze(), 
+                _metrics[i].get());
+        }
+        return frozen;
+    }
+    void predict_proba_one(std::span<const double> x, std::span<double> proba) override {
+        LatencyBudget::Scope timed(_predict_budget);
+        _predict_proba(x, proba);
+    }
+    // predict_one stops evaluating trees once the remaining ones cannot change its answer,
+    // which stays the argmax of predict_proba_one; trees_evaluated() tells how many it took
+    void set_early_exit_voting(bool enabled) { _early_exit_voting = enabled; }
+    int trees_evaluated() const { return _trees_evaluated; }
+    // Targets in nanoseconds for learn_one/predict_learn_one and for predictions, 0 turns
+    // a budget off. Over budget, learning drops a growing share of every tree's samples
+    // and defers split attempts, predictions vote with the heaviest trees only. What is
+    // shed depends on the measured timings, so a budgeted run is not reproducible.
+    void set_latency_budget(double learn_ns, double predict_ns) {
+        _learn_budget = LatencyBudget(learn_ns);
+        _predict_budget = LatencyBudget(predict_ns);
+        _train_keep = 1.0;
+        if (_splits_deferred) {
+            _splits_deferred = false;
+            for (int i=0;i<n_models;i++) _wait_background(i);
+            for (int i=0;i<2 * n_models;i++) {
+                _trees[i].set_defer_splits(false);
             }
         }
     }
-    std::vector<double> predict_proba_one(const std::vector<double>& x) {
-        std::vector<double> proba(num_labels, 0.0);
+    ARFLatencyStats latency_stats() const {
+        ARFLatencyStats stats;
+        stats.learn_ns = _learn_budget.ewma_ns();
+        stats.predict_ns = _predict_budget.ewma_ns();
+        stats.learn_level = _learn_budget.level();
+        stats.predict_level = _predict_budget.level();
+        stats.learn_over_budget = _learn_budget.over_budget();
+        stats.predict_over_budget = _predict_budget.over_budget();
+        for (int i=0;i<n_models;i++) {
+            stats.trainings_shed += _trainings_shed[i];
+        }
+        stats.split_attempts_deferred = _sum_trees<std::uint64_t>(&Tree::deferred_split_attempts, 
+            &BackgroundSlot::tree_deferred_splits);
+        stats.trees_shed = _trees_shed;
+        return stats;
+    }
+    int predict_one(std::span<const double> x) override {
+        LatencyBudget::Scope timed(_predict_budget);
+        // a shed prediction already stops after the heaviest trees
+        if (_early_exit_voting && models.size() != 0 && _predicted_trees() == n_models) {
+            return _predict_one_early_exit(x);
+        }
+        std::array<double, num_labels> proba;
+        _predict_proba(x, proba);
+        return std::distance(proba.begin(), std::max_element(proba.begin(), proba.end()));
+    }
+    // tree by tree over the whole block, weighted and normalised like predict_proba_one
+    void predict_proba_many(std::span<const double> x, std::span<double> proba, size_t n_rows) override {
+        std::fill(proba.begin(), proba.begin() + n_rows * num_labels, 0.0);
         if (models.size() == 0) {
             _init_ensemble();
-        } else {
-            for (int i=0;i<n_models;i++) {
-                Classifier* model = models[i];
-                std::vector<double> y_proba_temp = model->predict_proba_one(x);
-                double metric_value = _metrics[i].get();
+            return;
+        }
+        _batch_proba.resize(n_rows * num_labels);
+        for (int i=0;i<n_models;i++) {
+            models[i]->predict_proba_many(x, _batch_proba, n_rows);
+            double metric_value = _metrics[i].get();
+            for (size_t r=0;r<n_rows;r++) {
+                const double* y_proba_temp = &_batch_proba[r * num_labels];
+                if (_abstains(y_proba_temp)) continue;
                 for (int j=0;j<num_labels;j++) {
-                    proba[j] += (metric_value > 0.0) ? y_proba_temp[j] * metric_value : y_proba_temp[j];
+                    proba[r * num_labels + j] += (metric_value > 0.0) ? y_proba_temp[j] * metric_value : y_proba_temp[j];
                 }
             }
-            double total = std::accumulate(proba.begin(), proba.end(), 0.0);
+        }
+        for (size_t r=0;r<n_rows;r++) {
+            std::span<double> row = proba.subspan(r * num_labels, num_labels);
+            double total = std::accumulate(row.begin(), row.end(), 0.0);
             for (int i=0;i<num_labels;i++) {
                 if (total > 0.0) {
-                    proba[i] /= total;
+                    row[i] /= total;
                 } else {
-                    proba[i] = 0.0;
+                    row[i] = 0.0;
                 }
             }
         }
-        return proba;
     }
 };
 }
@@ -0,0 +1,259 @@
+# ifndef ASYNC_TRAINER_H
+# define ASYNC_TRAINER_H
+
+# include <algorithm>
+# include <array>
+# include <atomic>
+# include <chrono>
+# include <cstdint>
+# include <functional>
+# include <limits>
+# include <memory>
+# include <span>
+# include <thread>
+# include <utility>
+# include <vector>
+
+# include "BoundedQueue.h"
+
+namespace rivercpp {
+struct AsyncTrainerStats {
+    std::uint64_t submitted = 0;  // samples accepted into the queue
+    std::uint64_t rejected = 0;   // submit() calls refused because the queue was full
+    std::uint64_t waits = 0;      // times submit_wait() found the queue full and yielded
+    std::uint64_t trained = 0;    // samples the model has learned
+    std::uint64_t published = 0;  // snapshots published
+    std::uint64_t reclaimed = 0;  // retired snapshots freed once no reader could hold them
+    std::uint64_t staleness = 0;  // accepted samples the served snapshot does not reflect yet
+    size_t queue_depth = 0;
+};
+
+// Trains a model on its own thread and serves predictions from frozen snapshots.
+// Producers submit samples into a lock-free bounded queue; the trainer learns them in
+// order and publishes model->freeze() through an atomic pointer at least every
+// max_staleness samples and whenever it runs out of work. Snapshots are reclaimed by
+// epochs: a reader claims one of max_readers slots, each on its own cache line, and
+// writes there the epoch it read before loading the pointer. The trainer retires a
+// replaced snapshot at the current epoch, advances it, and frees the snapshot once no
+// slot holds an epoch up to that one. Readers write nothing but their slot and never
+// wait on training, unless more than max_readers of them read at once.
+// Model must provide learn_one(x, y, w) and a const freeze() whose result has
+// predict_proba_one(x, proba) and predict_one(x).
+template <int num_features, class Model>
+class AsyncTrainer {
+public:
+    using Snapshot = decltype(std::declval<const Model&>().freeze());
+private:
+    struct Sample {
+        std::array<double, num_features> x;
+        int y;
+        double w;
+    };
+    // 0 while free, otherwise the epoch its reader pinned
+    struct alignas(64) ReaderSlot {
+        std::atomic<std::uint64_t> epoch{0};
+    };
+    // claims a slot for one read, the snapshot loaded after it stays valid until release
+    class Pin {
+        ReaderSlot* slot;
+    public:
+        const Snapshot* snapshot;
+        explicit Pin(const AsyncTrainer& owner) : slot(&owner._claim_slot()),
+            snapshot(owner.current.load()) {}
+        Pin(const Pin&) = delete;
+        Pin& operator=(const Pin&) = delete;
+        ~Pin() { slot->epoch.store(0, std::memory_order_release); }
+    };
+    Model* model;
+    size_t max_staleness;
+    BoundedQueue<Sample> queue;
+    std::atomic<const Snapshot*> current{nullptr};
+    // starts at 1, so that no pinned epoch reads as a free slot
+    std::atomic<std::uint64_t> epoch{1};
+    size_t n_slots;
+    std::unique_ptr<ReaderSlot[]> slots;
+    // replaced snapshots and the epoch they were retired at, touched by the trainer only
+    std::vector<std::pair<const Snapshot*, std::uint64_t>> retired;
+    // bumped by producers and on shutdown, the idle trainer waits on it
+    std::atomic<std::uint64_t> wake{0};
+    std::atomic<bool> stop{false};
+    std::atomic<std::uint64_t> n_submitted{0};
+    std::atomic<std::uint64_t> n_rejected{0};
+    std::atomic<std::uint64_t> n_waits{0};
+    std::atomic<std::uint64_t> n_trained{0};
+    std::atomic<std::uint64_t> n_published{0};
+    std::atomic<std::uint64_t> n_reclaimed{0};
+    std::atomic<std::uint64_t> n_trained_at_publish{0};
+    std::thread trainer;
+
+    // A reader that pinned epoch e loaded the pointer after reading e, so it can only
+    // hold snapshots retired at e or later: the replacing store comes before the epoch
+    // moves past e. The compare-exchange is sequentially consistent with the trainer's
+    // exchange and slot scan, so a reader the scan misses loads the new pointer.
+    ReaderSlot& _claim_slot() const {
+        thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+        for (size_t tried=0;;tried++, hint++) {
+            ReaderSlot& slot = slots[hint % n_slots];
+            std::uint64_t free = 0;
+            if (slot.epoch.load(std::memory_order_relaxed) == 0 
+                && slot.epoch.compare_exchange_strong(free, epoch.load())) {
+                return slot;
+            }
+            if (tried % n_slots == n_slots - 1) std::this_thread::yield();
+        }
+    }
+    void _reclaim() {
+        if (retired.empty()) return;
+        std::uint64_t oldest_pinned = std::numeric_limits<std::uint64_t>::max();
+        for (size_t i=0;i<n_slots;i++) {
+            std::uint64_t pinned = slots[i].epoch.load();
+            if (pinned != 0) oldest_pinned = std::min(oldest_pinned, pinned);
+        }
+        size_t n_freed = std::erase_if(retired, [&](const std::pair<const Snapshot*, std::uint64_t>& entry) {
+            if (entry.second >= oldest_pinned) return false;
+            delete entry.first;
+            return true;
+        });
+        n_reclaimed.fetch_add(n_freed, std::memory_order_relaxed);
+    }
+    void _publish(std::uint64_t trained) {
+        const Snapshot* replaced = current.exchange(new Snapshot(model->freeze()));
+        if (replaced != nullptr) retired.emplace_back(replaced, epoch.fetch_add(1));
+        n_trained_at_publish.store(trained, std::memory_order_release);
+        n_published.fetch_add(1, std::memory_order_relaxed);
+        _reclaim();
+    }
+    void _run() {
+        Sample sample;
+        std::uint64_t trained = 0;
+        std::uint64_t since_publish = 0;
+        while (true) {
+            if (queue.try_pop(sample)) {
+                model->learn_one(std::span<const double>(sample.x), sample.y, sample.w);
+                n_trained.store(++trained, std::memory_order_relaxed);
+                if (++since_publish >= max_staleness) {
+                    _publish(trained);
+                    since_publish = 0;
+                }
+                continue;
+            }
+            if (since_publish > 0) {
+                _publish(trained);
+                since_publish = 0;
+                continue;
+            }
+            // snapshots still pinned when the last one was published, readers do not
+            // signal their release, so an idle trainer polls until they are freed
+            _reclaim();
+            // the queue is drained before shutting down
+            std::uint64_t seen = wake.load(std::memory_order_acquire);
+            if (queue.size_approx() > 0) continue;
+            if (stop.load(std::memory_order_acquire)) break;
+            if (!retired.empty()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+            wake.wait(seen, std::memory_order_acquire);
+        }
+    }
+    void _notify() {
+        wake.fetch_add(1, std::memory_order_release);
+        wake.notify_one();
+    }
+public:
+    // takes ownership of model, which must not be used directly while the trainer runs.
+    // max_readers is the number of reads that can be in flight at once
+    AsyncTrainer(Model* model, size_t queue_capacity = 1024, size_t max_staleness = 256, 
+        size_t max_readers = 64)
+        : model(model), max_staleness(std::max<size_t>(max_staleness, 1)), queue(queue_capacity), 
+        n_slots(std::max<size_t>(max_readers, 1)), slots(new ReaderSlot[n_slots]) {
+        _publish(0);
+        trainer = std::thread([this] { _run(); });
+    }
+    AsyncTrainer(const AsyncTrainer&) = delete;
+    AsyncTrainer& operator=(const AsyncTrainer&) = delete;
+    // every read must have returned
+    ~AsyncTrainer() {
+        stop.store(true, std::memory_order_release);
+        _notify();
+        trainer.join();
+        for (const std::pair<const Snapshot*, std::uint64_t>& entry : retired) delete entry.first;
+        delete current.load();
+        delete model;
+    }
+
+    // never blocks, false when the queue is full and the sample was dropped
+    bool submit(std::span<const double> x, int y, double w=1.0) {
+        Sample sample;
+        std::copy_n(x.begin(), num_features, sample.x.begin());
+        sample.y = y;
+        sample.w = w;
+        if (!queue.try_push(sample)) {
+            n_rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        n_submitted.fetch_add(1, std::memory_order_relaxed);
+        _notify();
+        return true;
+    }
+    // yields until the trainer makes room, for producers that must not drop samples
+    void submit_wait(std::span<const double> x, int y, double w=1.0) {
+        Sample sample;
+        std::copy_n(x.begin(), num_features, sample.x.begin());
+        sample.y = y;
+        sample.w = w;
+        while (!queue.try_push(sample)) {
+            n_waits.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+        n_submitted.fetch_add(1, std::memory_order_relaxed);
+        _notify();
+    }
+
+    // calls f with the served snapshot, which stays valid until f returns
+    template <class F>
+    decltype(auto) read(F&& f) const {
+        Pin pin(*this);
+        return std::forward<F>(f)(*pin.snapshot);
+    }
+    // proba holds the model's number of classes and is overwritten
+    void predict_proba_one(std::span<const double> x, std::span<double> proba) const {
+        std::fill(proba.begin(), proba.end(), 0.0);
+        Pin pin(*this);
+        pin.snapshot->predict_proba_one(x, proba);
+    }
+    // allocating form
+    std::vector<double> predict_proba_one(std::span<const double> x) const {
+        Pin pin(*this);
+        return pin.snapshot->predict_proba_one(x);
+    }
+    int predict_one(std::span<const double> x) const {
+        Pin pin(*this);
+        return pin.snapshot->predict_one(x);
+    }
+
+    // blocks until every sample submitted so far is in the served snapshot
+    void flush() {
+        std::uint64_t target = n_submitted.load(std::memory_order_acquire);
+        while (n_trained_at_publish.load(std::memory_order_acquire) < target) {
+            std::this_thread::yield();
+        }
+    }
+
+    AsyncTrainerStats stats() const {
+        AsyncTrainerStats s;
+        s.submitted = n_submitted.load(std::memory_order_relaxed);
+        s.rejected = n_rejected.load(std::memory_order_relaxed);
+        s.waits = n_waits.load(std::memory_order_relaxed);
+        s.trained = n_trained.load(std::memory_order_relaxed);
+        s.published = n_published.load(std::memory_order_relaxed);
+        s.reclaimed = n_reclaimed.load(std::memory_order_relaxed);
+        std::uint64_t reflected = n_trained_at_publish.load(std::memory_order_relaxed);
+        s.staleness = s.submitted > reflected ? s.submitted - reflected : 0;
+        s.queue_depth = queue.size_approx();
+        return s;
+    }
+};
+}
+
+# endif
\ No newline at end of file
@@ -1,8 +1,151 @@
 # ifndef BRANCH_H
 # define BRANCH_H
 
+# include <cstdint>
+# include <vector>
+
+# include "SlotPool.h"
+
 namespace rivercpp {
-    
+// 32-bit node handle, leaves are tagged with the high bit and index the leaf table,
+// everything else indexes the branch table
+using NodeRef = std::uint32_t;
+constexpr NodeRef LEAF_BIT = 0x80000000u;
+constexpr NodeRef NO_NODE = 0xffffffffu;
+
+inline bool is_leaf_ref(NodeRef ref) { return (ref & LEAF_BIT) != 0; }
+inline NodeRef leaf_ref(std::uint32_t idx) { return idx | LEAF_BIT; }
+inline std::uint32_t leaf_index(NodeRef ref) { return ref & ~LEAF_BIT; }
+
+// under gaussian splitter we always use this branch
+struct NumericBinaryBranch {
+    double threshold;
+    NodeRef children[2];
+    int feature;
+    template <class X>
+    inline int branch_no(const X& x) const { return x[feature] <= threshold ? 0 : 1; }
+};
+
+// Owns the nodes of one tree: hot branch records are packed in one vector,
+// cold leaf objects live in the tree's own slot pool and their table entries
+// are recycled through a free list
+template <class Leaf>
+class NodeArena {
+private:
+    std::vector<std::uint32_t> free_leaves;
+    SlotPool leaf_pool;
+public:
+    std::vector<NumericBinaryBranch> branches;
+    std::vector<Leaf*> leaves;
+    NodeRef root = NO_NODE;
+
+    // leaf_slot_size must fit every leaf type the tree creates
+    explicit NodeArena(size_t leaf_slot_size) : leaf_pool(leaf_slot_size) {}
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+    ~NodeArena() { clear(); }
+
+    bool empty() const { return root == NO_NODE; }
+    size_t n_branches() const { return branches.size(); }
+    size_t n_leaves() const { return leaves.size() - free_leaves.size(); }
+    Leaf* leaf(NodeRef ref) const { return leaves[leaf_index(ref)]; }
+    size_t leaf_slot_size() const { return leaf_pool.get_slot_size(); }
+    // live bytes of the branch and leaf tables and of the leaves themselves
+    size_t memory_usage() const {
+        return branches.capacity() * sizeof(NumericBinaryBranch) + leaves.capacity() * sizeof(Leaf*)
+            + free_leaves.capacity() * sizeof(std::uint32_t) + leaf_pool.bytes_in_use();
+    }
+
+    // construct a leaf in the pool, it joins the tree through add_leaf
+    template <class L, class... Args>
+    L* create_leaf(Args&&... args) {
+        return leaf_pool.create<L>(std::forward<Args>(args)...);
+    }
+    NodeRef add_leaf(Leaf* leaf) {
+        if (!free_leaves.empty()) {
+            std::uint32_t idx = free_leaves.back();
+            free_leaves.pop_back();
+            leaves[idx] = leaf;
+            return leaf_ref(idx);
+        }
+        leaves.push_back(leaf);
+        return leaf_ref(leaves.size() - 1);
+    }
+    // the leaf is deactivated first so its splitters go back to their pool
+    void remove_leaf(NodeRef ref) {
+        std::uint32_t idx = leaf_index(ref);
+        leaves[idx]->deactivate();
+        leaf_pool.deallocate(leaves[idx]);
+        leaves[idx] = nullptr;
+        free_leaves.push_back(idx);
+    }
+    NodeRef add_branch(const NumericBinaryBranch& branch) {
+        branches.push_back(branch);
+        return branches.size() - 1;
+    }
+    // hang node where parent's child (or the root) used to be
+    void replace(NodeRef parent, int parent_branch, NodeRef node) {
+        if (parent == NO_NODE) root = node;
+        else branches[parent].children[parent_branch] = node;
+    }
+
+    template <class X>
+    NodeRef traverse(const X& x) const {
+        NodeRef node = root;
+        while (!is_leaf_ref(node)) {
+            const NumericBinaryBranch& b = branches[node];
+            node = b.children[b.branch_no(x)];
+        }
+        return node;
+    }
+    // also reports the last branch passed and the side taken there
+    template <class X>
+    NodeRef traverse(const X& x, NodeRef& parent, int& parent_branch) const {
+        NodeRef node = root;
+        parent = NO_NODE;
+        parent_branch = 0;
+        while (!is_leaf_ref(node)) {
+            const NumericBinaryBranch& b = branches[node];
+            parent = node;
+            parent_branch = b.branch_no(x);
+            node = b.children[parent_branch];
+        }
+        return node;
+    }
+
+    // breadth-wise traversal of a row-major block, every row moves one level per pass
+    void traverse_many(const double* x, size_t n_rows, size_t n_cols, NodeRef* out) const {
+        for (size_t r=0;r<n_rows;r++) out[r] = root;
+        bool moved = !is_leaf_ref(root);
+        while (moved) {
+            moved = false;
+            for (size_t r=0;r<n_rows;r++) {
+                NodeRef node = out[r];
+                if (is_leaf_ref(node)) continue;
+                const NumericBinaryBranch& b = branches[node];
+                out[r] = b.children[b.branch_no(x + r * n_cols)];
+                moved = true;
+            }
+        }
+    }
+
+    // drops every node but keeps the tables' capacity and the pool's chunks for reuse
+    void reset() {
+        leaf_pool.clear();
+        leaves.clear();
+        free_leaves.clear();
+        branches.clear();
+        root = NO_NODE;
+    }
+    // leaves are trivially destructible, so dropping the pool frees them all at once
+    void clear() {
+        leaf_pool.release();
+        leaves.clear();
+        free_leaves.clear();
+        branches.clear();
+        root = NO_NODE;
+    }
+};
 }
 
 # endif
\ No newline at end of file
@@ -2,17 +2,56 @@
 # define CLASSIFIER_H
 
 # include <vector>
+# include <span>
 # include <algorithm>
 
 namespace rivercpp {
+// The span forms are the interface: x is read in place and proba, num_classes() values,
+// is written into caller-owned storage, so learning and predicting need not allocate.
+// The std::vector overloads forward to them and stay virtual for existing callers.
 class Classifier {
 public:
-    virtual void learn_one(const std::vector<double>& x, int y, double w=1.0) = 0;
-    virtual std::vector<double> predict_proba_one(const std::vector<double>& x) = 0;
-    virtual int predict_one(const std::vector<double>& x) {
-        std::vector<double> proba = predict_proba_one(x);
+    virtual int num_classes() const = 0;
+    virtual void learn_one(std::span<const double> x, int y, double w=1.0) = 0;
+    virtual void predict_proba_one(std::span<const double> x, std::span<double> proba) = 0;
+    // models with a fixed number of classes override it with a stack buffer
+    virtual int predict_one(std::span<const double> x) {
+        thread_local std::vector<double> proba;
+        proba.resize(num_classes());
+        predict_proba_one(x, proba);
         return std::distance(proba.begin(), std::max_element(proba.begin(), proba.end()));
     }
+    virtual void learn_one(const std::vector<double>& x, int y, double w=1.0) {
+        learn_one(std::span<const double>(x), y, w);
+    }
+    // allocating form, derived classes bring it in with a using-declaration
+    virtual std::vector<double> predict_proba_one(const std::vector<double>& x) {
+        std::vector<double> proba(num_classes(), 0.0);
+        predict_proba_one(std::span<const double>(x), proba);
+        return proba;
+    }
+    virtual int predict_one(const std::vector<double>& x) {
+        return predict_one(std::span<const double>(x));
+    }
+    // test-then-train: the prediction for x made before learning from it. Models that can
+    // reuse the work of the prediction while learning override it
+    virtual int predict_learn_one(std::span<const double> x, int y, double w=1.0) {
+        int y_pred = predict_one(x);
+        learn_one(x, y, w);
+        return y_pred;
+    }
+    virtual int predict_learn_one(const std::vector<double>& x, int y, double w=1.0) {
+        return predict_learn_one(std::span<const double>(x), y, w);
+    }
+    // x holds n_rows row-major samples, proba receives n_rows row-major probability vectors
+    virtual void predict_proba_many(std::span<const double> x, std::span<double> proba, size_t n_rows) {
+        if (n_rows == 0) return;
+        size_t n_cols = x.size() / n_rows;
+        size_t n_out = proba.size() / n_rows;
+        for (size_t r=0;r<n_rows;r++) {
+            predict_proba_one(x.subspan(r * n_cols, n_cols), proba.subspan(r * n_out, n_out));
+        }
+    }
     virtual ~Classifier() = default;
 };
 }
@@ -0,0 +1,36 @@
+# ifndef COUNTER_RNG_H
+# define COUNTER_RNG_H
+
+# include <cstdint>
+
+namespace rivercpp {
+// Counter-based UniformRandomBitGenerator: draw n of stream (seed, stream) is SplitMix64
+// applied to a key made from both plus n, so every stream is independent of how many
+// draws the others made and of which thread makes them.
+class CounterRNG {
+private:
+    std::uint64_t key = 0;
+    std::uint64_t counter = 0;
+    static constexpr std::uint64_t _mix(std::uint64_t z) {
+        z += 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+public:
+    using result_type = std::uint64_t;
+    CounterRNG() = default;
+    CounterRNG(std::uint64_t seed, std::uint64_t stream) : key(_mix(_mix(seed) ^ stream)) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type(0); }
+    result_type operator()() { return _mix(key + 0x9e3779b97f4a7c15ull * counter++); }
+};
+
+// stream id of one ensemble slot, generation tells apart the trees that held the slot
+constexpr std::uint64_t slot_stream(std::uint32_t slot, std::uint32_t generation) {
+    return (static_cast<std::uint64_t>(slot) << 32) | generation;
+}
+}
+
+# endif
\ No newline at end of file
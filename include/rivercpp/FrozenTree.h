@@ -0,0 +1,214 @@
+# ifndef FROZEN_TREE_H
+# define FROZEN_TREE_H
+
+# include <algorithm>
+# include <array>
+# include <bit>
+# include <cstdint>
+# include <span>
+# include <vector>
+
+# include "Branch.h"
+# include "GaussianNBTable.h"
+# include "utils.h"
+
+namespace rivercpp {
+// Read-only snapshot of a trained HoeffdingTreeClassifier, evaluated QuickScorer style:
+// leaves are numbered left to right and kept in a bitvector, every branch whose test fails
+// clears the leaves of its left subtree, and the first surviving leaf is the exit leaf.
+// Branches are grouped per feature and sorted by threshold, so each feature is a linear
+// scan that stops at the first test that holds. All methods are const and lock free.
+template <int num_features, int num_labels>
+class FrozenTree {
+private:
+    struct Node {
+        double threshold;
+        // leaves of the left subtree, [left_begin, left_end)
+        std::uint32_t left_begin;
+        std::uint32_t left_end;
+    };
+    struct Leaf {
+        std::array<double, num_labels> stats;
+        // naive bayes features are nb_features[nb_begin, nb_begin + nb_size), their
+        // mean, half_inv_var and log_norm rows start at nb_params[nb_param_begin]
+        std::uint32_t nb_begin;
+        std::uint32_t nb_size;
+        std::uint32_t nb_param_begin;
+        bool use_naive_bayes;
+    };
+    static constexpr size_t inline_words = 64;
+
+    std::array<std::uint32_t, num_features + 1> feature_offsets{};
+    std::vector<Node> nodes;
+    std::vector<Leaf> leaves;
+    std::vector<int> nb_features;
+    std::vector<double> nb_params;
+    size_t n_words = 0;
+
+    template <class TreeLeaf>
+    void _build(const NodeArena<TreeLeaf>& arena, NodeRef ref, std::array<std::vector<Node>, num_features>& per_feature) {
+        if (is_leaf_ref(ref)) {
+            const TreeLeaf* tree_leaf = arena.leaf(ref);
+            Leaf leaf{tree_leaf->stats, static_cast<std::uint32_t>(nb_features.size()), 0,
+                static_cast<std::uint32_t>(nb_params.size()), tree_leaf->predicts_with_naive_bayes()};
+            if (leaf.use_naive_bayes) {
+                const auto& table = tree_leaf->nb_table();
+                int width = nb_padded(table.size());
+                leaf.nb_size = table.size();
+                for (int s=0;s<table.size();s++) nb_features.push_back(table.feature(s));
+                for (int c=0;c<num_labels;c++) nb_params.insert(nb_params.end(), table.mean(c), table.mean(c) + width);
+                for (int c=0;c<num_labels;c++) nb_params.insert(nb_params.end(), table.half_inv_var(c), table.half_inv_var(c) + width);
+                for (int c=0;c<num_labels;c++) nb_params.insert(nb_params.end(), table.log_norm(c), table.log_norm(c) + width);
+            }
+            leaves.push_back(leaf);
+            return;
+        }
+        const NumericBinaryBranch& branch = arena.branches[ref];
+        std::uint32_t left_begin = leaves.size();
+        _build(arena, branch.children[0], per_feature);
+        per_feature[branch.feature].push_back(Node{branch.threshold, left_begin, static_cast<std::uint32_t>(leaves.size())});
+        _build(arena, branch.children[1], per_feature);
+    }
+    static void _clear_leaves(std::uint64_t* bits, std::uint32_t begin, std::uint32_t end) {
+        std::uint32_t first = begin >> 6;
+        std::uint32_t last = (end - 1) >> 6;
+        std::uint64_t lo = ~0ull << (begin & 63);
+        std::uint64_t hi = ~0ull >> (63 - ((end - 1) & 63));
+        if (first == last) {
+            bits[first] &= ~(lo & hi);
+            return;
+        }
+        bits[first] &= ~lo;
+        for (std::uint32_t w=first+1;w<last;w++) bits[w] = 0;
+        bits[last] &= ~hi;
+    }
+    std::uint32_t _find_leaf(std::span<const double> x, std::uint64_t* bits) const {
+        std::fill(bits, bits + n_words, ~0ull);
+        for (int f=0;f<num_features;f++) {
+            for (std::uint32_t k=feature_offsets[f];k<feature_offsets[f+1];k++) {
+                // same test as NumericBinaryBranch::branch_no, so NaN goes right here as well
+                if (x[f] <= nodes[k].threshold) break;
+                _clear_leaves(bits, nodes[k].left_begin, nodes[k].left_end);
+            }
+        }
+        for (size_t w=0;w<n_words;w++) {
+            if (bits[w]) return w * 64 + std::countr_zero(bits[w]);
+        }
+        return 0;
+    }
+public:
+    FrozenTree() = default;
+    template <class TreeLeaf>
+    explicit FrozenTree(const NodeArena<TreeLeaf>& arena) {
+        if (arena.empty()) return;
+        std::array<std::vector<Node>, num_features> per_feature;
+        _build(arena, arena.root, per_feature);
+        for (int f=0;f<num_features;f++) {
+            std::stable_sort(per_feature[f].begin(), per_feature[f].end(),
+                [](const Node& a, const Node& b) { return a.threshold < b.threshold; });
+            feature_offsets[f] = nodes.size();
+            nodes.insert(nodes.end(), per_feature[f].begin(), per_feature[f].end());
+        }
+        feature_offsets[num_features] = nodes.size();
+        n_words = (leaves.size() + 63) / 64;
+    }
+
+    size_t n_leaves() const { return leaves.size(); }
+    size_t memory_bytes() const {
+        return sizeof(*this) + nodes.capacity() * sizeof(Node) + leaves.capacity() * sizeof(Leaf)
+            + nb_features.capacity() * sizeof(int) + nb_params.capacity() * sizeof(double);
+    }
+
+    // proba must hold num_labels zeros, as for HoeffdingTreeClassifier::predict_proba_one
+    template <class Proba>
+    void predict_proba_one(std::span<const double> x, Proba& proba) const {
+        if (leaves.empty()) return;
+        std::uint32_t idx;
+        if (n_words <= inline_words) {
+            std::array<std::uint64_t, inline_words> bits;
+            idx = _find_leaf(x, bits.data());
+        } else {
+            std::vector<std::uint64_t> bits(n_words);
+            idx = _find_leaf(x, bits.data());
+        }
+        const Leaf& leaf = leaves[idx];
+        if (leaf.use_naive_bayes) {
+            int width = nb_padded(leaf.nb_size);
+            std::array<double, nb_padded(num_features)> xs;
+            for (int s=0;s<width;s++) xs[s] = s < static_cast<int>(leaf.nb_size) ? x[nb_features[leaf.nb_begin + s]] : 0.0;
+            const double* params = nb_params.data() + leaf.nb_param_begin;
+            naive_bayes_vote<num_labels>(proba, leaf.stats, [&](int c, double& vote) {
+                add_gaussian_log_likelihood(vote, xs.data(), params + c * width,
+                    params + (num_labels + c) * width, params + (2 * num_labels + c) * width, width);
+            });
+        } else {
+            normalize_values_in_dict(proba, leaf.stats);
+        }
+    }
+    std::vector<double> predict_proba_one(std::span<const double> x) const {
+        std::vector<double> proba(num_labels, 0.0);
+        predict_proba_one(x, proba);
+        return proba;
+    }
+    int predict_one(std::span<const double> x) const {
+        std::array<double, num_labels> proba{};
+        predict_proba_one(x, proba);
+        return std::distance(proba.begin(), std::max_element(proba.begin(), proba.end()));
+    }
+};
+
+// Frozen ARFClassifier: the frozen trees plus the accuracy weights they had at freeze time
+template <int num_features, int num_labels>
+class FrozenForest {
+private:
+    std::vector<FrozenTree<num_features, num_labels>> trees;
+    std::vector<double> weights;
+public:
+    void add_tree(FrozenTree<num_features, num_labels>&& tree, double metric_value) {
+        trees.push_back(std::move(tree));
+        weights.push_back(metric_value);
+    }
+    size_t n_trees() const { return trees.size(); }
+    size_t memory_bytes() const {
+        size_t total = sizeof(*this) + weights.capacity() * sizeof(double);
+        for (const auto& tree : trees) total += tree.memory_bytes();
+        return total;
+    }
+
+    template <class Proba>
+    void predict_proba_one(std::span<const double> x, Proba& proba) const {
+        std::fill(proba.begin(), proba.end(), 0.0);
+        if (trees.empty()) return;
+        for (size_t i=0;i<trees.size();i++) {
+            std::array<double, num_labels> y_proba_temp{};
+            trees[i].predict_proba_one(x, y_proba_temp);
+            // a tree voting NaN abstains, as in ARFClassifier
+            if (std::isnan(y_proba_temp[0])) continue;
+            double metric_value = weights[i];
+            for (int j=0;j<num_labels;j++) {
+                proba[j] += (metric_value > 0.0) ? y_proba_temp[j] * metric_value : y_proba_temp[j];
+            }
+        }
+        double total = std::accumulate(proba.begin(), proba.end(), 0.0);
+        for (int i=0;i<num_labels;i++) {
+            if (total > 0.0) {
+                proba[i] /= total;
+            } else {
+                proba[i] = 0.0;
+            }
+        }
+    }
+    std::vector<double> predict_proba_one(std::span<const double> x) const {
+        std::vector<double> proba(num_labels, 0.0);
+        predict_proba_one(x, proba);
+        return proba;
+    }
+    int predict_one(std::span<const double> x) const {
+        std::array<double, num_labels> proba{};
+        predict_proba_one(x, proba);
+        return std::distance(proba.begin(), std::max_element(proba.begin(), proba.end()));
+    }
+};
+}
+
+# endif
\ No newline at end of file
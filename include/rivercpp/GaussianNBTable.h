@@ -0,0 +1,148 @@
+# ifndef GAUSSIAN_NB_TABLE_H
+# define GAUSSIAN_NB_TABLE_H
+
+# include <algorithm>
+# include <bit>
+# include <cstddef>
+# include <cmath>
+# include <limits>
+# include <span>
+
+# if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+# include <immintrin.h>
+# endif
+
+namespace rivercpp {
+// rows are padded to the widest kernel, padding lanes hold zeros and add nothing
+constexpr int nb_padded(int n) { return (n + 7) & ~7; }
+
+// log of the smallest denormal, a density below it used to round to zero
+constexpr double nb_min_log_density = -744.44007192138122;
+
+// Sums log N(x_j | mean_j, var_j) = log_norm_j - half_inv_var_j * (x_j - mean_j)^2 over n (padded) lanes.
+// Terms whose density would be zero (var == 0 is stored as log_norm = -inf) are counted, not summed.
+inline void gaussian_log_density_sum(const double* x, const double* mean, const double* half_inv_var,
+    const double* log_norm, int n, double& sum, int& n_degenerate) {
+    n_degenerate = 0;
+# if defined(__AVX512F__)
+    const __m512d lim = _mm512_set1_pd(nb_min_log_density);
+    __m512d acc = _mm512_setzero_pd();
+    for (int j=0;j<n;j+=8) {
+        __m512d d = _mm512_sub_pd(_mm512_loadu_pd(x + j), _mm512_loadu_pd(mean + j));
+        __m512d t = _mm512_fnmadd_pd(_mm512_mul_pd(d, d), _mm512_loadu_pd(half_inv_var + j), _mm512_loadu_pd(log_norm + j));
+        __mmask8 zero_density = _mm512_cmp_pd_mask(t, lim, _CMP_LT_OQ);
+        acc = _mm512_mask_add_pd(acc, static_cast<__mmask8>(~zero_density), acc, t);
+        n_degenerate += std::popcount(static_cast<unsigned>(zero_density));
+    }
+    // GCC 12 builds _mm512_reduce_add_pd, _mm512_castpd512_pd256 and _mm512_extractf64x4_pd
+    // on an undefined vector and warns with -Wmaybe-uninitialized, zero-masked extracts do not
+    __m256d quarter = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xFF, acc, 0), _mm512_maskz_extractf64x4_pd(0xFF, acc, 1));
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(quarter), _mm256_extractf128_pd(quarter, 1));
+    sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+# elif defined(__AVX2__) && defined(__FMA__)
+    const __m256d lim = _mm256_set1_pd(nb_min_log_density);
+    __m256d acc = _mm256_setzero_pd();
+    for (int j=0;j<n;j+=4) {
+        __m256d d = _mm256_sub_pd(_mm256_loadu_pd(x + j), _mm256_loadu_pd(mean + j));
+        __m256d t = _mm256_fnmadd_pd(_mm256_mul_pd(d, d), _mm256_loadu_pd(half_inv_var + j), _mm256_loadu_pd(log_norm + j));
+        __m256d zero_density = _mm256_cmp_pd(t, lim, _CMP_LT_OQ);
+        acc = _mm256_add_pd(acc, _mm256_andnot_pd(zero_density, t));
+        n_degenerate += std::popcount(static_cast<unsigned>(_mm256_movemask_pd(zero_density)));
+    }
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+# else
+    sum = 0.0;
+    for (int j=0;j<n;j++) {
+        double d = x[j] - mean[j];
+        double t = log_norm[j] - d * d * half_inv_var[j];
+        if (t < nb_min_log_density) n_degenerate++;
+        else sum += t;
+    }
+# endif
+}
+
+inline void add_gaussian_log_likelihood(double& vote, const double* x, const double* mean,
+    const double* half_inv_var, const double* log_norm, int n) {
+    double sum;
+    int n_degenerate;
+    gaussian_log_density_sum(x, mean, half_inv_var, log_norm, n, sum, n_degenerate);
+    vote += sum;
+    // a zero density adds lowest(), two of them saturate to -inf
+    for (int k=0;k<n_degenerate && k<2;k++) {
+        vote += std::numeric_limits<double>::lowest();
+    }
+}
+
+// Structure-of-arrays view of a leaf's gaussian splitters for naive bayes prediction,
+// one padded row per class over the leaf's features, slot s for its s-th feature. The
+// mean, half_inv_var and log_norm rows and the feature list share one block of
+// block_bytes(n) bytes that the leaf takes from its tree's pool and returns on deactivate
+template <int num_features, int num_labels>
+class GaussianNBTable {
+public:
+    static constexpr int max_stride = nb_padded(num_features);
+    static constexpr size_t block_bytes(int n) {
+        return 3 * num_labels * nb_padded(n) * sizeof(double) + n * sizeof(int);
+    }
+private:
+    double* _block = nullptr;
+    int stride = 0;
+    int n_slots = 0;
+    int* _features() const { return reinterpret_cast<int*>(_block + 3 * num_labels * stride); }
+    double* _row(int kind, int c) const { return _block + (kind * num_labels + c) * stride; }
+public:
+    bool empty() const { return _block == nullptr; }
+    int size() const { return n_slots; }
+    int feature(int slot) const { return _features()[slot]; }
+    const double* mean(int c) const { return _row(0, c); }
+    const double* half_inv_var(int c) const { return _row(1, c); }
+    const double* log_norm(int c) const { return _row(2, c); }
+
+    // takes block for features[0, n), fresh splitters have seen nothing, so every class
+    // starts with zero density
+    void assign(void* block, const int* features, int n) {
+        _block = static_cast<double*>(block);
+        stride = nb_padded(n);
+        n_slots = n;
+        std::fill(_block, _block + 3 * num_labels * stride, 0.0);
+        for (int c=0;c<num_labels;c++) {
+            std::fill(_row(2, c), _row(2, c) + n, -std::numeric_limits<double>::infinity());
+        }
+        std::copy(features, features + n, _features());
+    }
+    // hands the block back to the caller and leaves the table empty
+    void* release() {
+        void* block = _block;
+        _block = nullptr;
+        stride = n_slots = 0;
+        return block;
+    }
+    template <class G>
+    void set(int slot, int c, const G& dist) {
+        double var = dist.get_var();
+        int idx = c * stride + slot;
+        if (var == 0.0) {
+            _block[idx] = 0.0;
+            _block[num_labels * stride + idx] = 0.0;
+            _block[2 * num_labels * stride + idx] = -std::numeric_limits<double>::infinity();
+        } else {
+            _block[idx] = dist.get_mean();
+            _block[num_labels * stride + idx] = 0.5 / var;
+            _block[2 * num_labels * stride + idx] = -0.5 * std::log(2 * M_PI * var);
+        }
+    }
+    // xs must hold max_stride values
+    void gather(std::span<const double> x, double* xs) const {
+        const int* features = _features();
+        int s = 0;
+        for (;s<n_slots;s++) xs[s] = x[features[s]];
+        for (;s<nb_padded(n_slots);s++) xs[s] = 0.0;
+    }
+    void add_log_likelihood(const double* xs, int c, double& vote) const {
+        add_gaussian_log_likelihood(vote, xs, mean(c), half_inv_var(c), log_norm(c), nb_padded(n_slots));
+    }
+};
+}
+
+# endif
\ No newline at end of file
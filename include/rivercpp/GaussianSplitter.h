@@ -1,10 +1,11 @@
 # ifndef GAUSSIAN_SPLITTER_H
 # define GAUSSIAN_SPLITTER_H
 
+# include <algorithm>
 # include <cmath>
 # include <limits>
 # include <vector>
-# include <unordered_map>
+# include <array>
 # include "TreeBase.h"
 
 namespace rivercpp {
@@ -21,18 +22,19 @@ public:
         _mean += (w / n) * (x - _mean);
         _S += w * (x - mean_old) * (x - _mean);
     }
-    double get_var() {
+    double get_mean() const { return _mean; }
+    double get_var() const {
         if (n > ddof) {
             return _S / (n - ddof);
         }
         return 0.0;
     }
-    double cdf(double x) {
+    double cdf(double x) const {
         double var = get_var();
         if (var == 0.0) return 0.0;
         return 0.5 * (1.0 + std::erf((x - _mean) / std::sqrt(var * 2.0)));
     }
-    double operator()(double x) {
+    double operator()(double x) const {
         double var = get_var();
         if (var == 0.0) return 0.0;
         return std::exp(-0.5 * (x - _mean) * (x - _mean) / var) / std::sqrt(2 * M_PI * var);
@@ -42,13 +44,12 @@ public:
 template <int num_features, int num_labels>
 class GaussianSplitter {
 private:
-    std::vector<Gaussian> _att_dist_per_class{std::vector<Gaussian>(num_labels)};
-    std::vector<double> _min_per_class{std::vector<double>(num_labels, std::numeric_limits<double>::max())};
-    std::vector<double> _max_per_class{std::vector<double>(num_labels, std::numeric_limits<double>::lowest())};
+    std::array<Gaussian, num_labels> _att_dist_per_class{};
+    std::array<double, num_labels> _min_per_class;
+    std::array<double, num_labels> _max_per_class;
     int n_split;
-    std::vector<double> _split_point_suggestions() {
-        std::vector<double> res;
-        res.reserve(n_split);
+    void _split_point_suggestions(std::vector<double>& res) const {
+        res.clear();
         double min_value = std::numeric_limits<double>::max();
         double max_value = std::numeric_limits<double>::lowest();
         for (int i=0;i<num_labels;i++) {
@@ -63,42 +64,69 @@ private:
                 if (split_value > min_value && split_value < max_value) res.push_back(split_value);
             }
         }
-        return res;
     }
-    std::pair<std::vector<double>, std::vector<double> > _class_dists_from_binary_split(double split_value) {
-        std::vector<double> lhs_dist(num_labels, -1.0);
-        std::vector<double> rhs_dist(num_labels, -1.0);
+    // Fills the class distributions of every candidate at once, candidate k owns
+    // lhs[k * num_labels, (k + 1) * num_labels). Classes that fall entirely on one side
+    // keep -1 on the other, as the single-candidate version always did.
+    void _class_dists_from_binary_splits(const std::vector<double>& split_values, 
+        std::vector<double>& lhs, std::vector<double>& rhs) const {
+        size_t n = split_values.size();
+        lhs.resize(n * num_labels);
+        rhs.resize(n * num_labels);
         for (int i=0;i<num_labels;i++) {
-            if (split_value < _min_per_class[i]) {
-                rhs_dist[i] = _att_dist_per_class[i].n;
-            } else if (split_value >= _max_per_class[i]) {
-                lhs_dist[i] = _att_dist_per_class[i].n;
-            } else {
-                lhs_dist[i] = _att_dist_per_class[i].cdf(split_value) * _att_dist_per_class[i].n;
-                rhs_dist[i] = _att_dist_per_class[i].n - lhs_dist[i];
+            const Gaussian& dist = _att_dist_per_class[i];
+            // same arithmetic as Gaussian::cdf with the class mean and scale hoisted out of
+            // the candidate loop; std::erf stays one libm call per candidate, so the loop
+            // is not vectorized, and classes outside a candidate's range skip it
+            double var = dist.get_var();
+            double mean = dist.get_mean();
+            double scale = std::sqrt(var * 2.0);
+            for (size_t k=0;k<n;k++) {
+                double split_value = split_values[k];
+                double l = -1.0, r = -1.0;
+                if (split_value < _min_per_class[i]) {
+                    r = dist.n;
+                } else if (split_value >= _max_per_class[i]) {
+                    l = dist.n;
+                } else {
+                    double cdf = var == 0.0 ? 0.0 : 0.5 * (1.0 + std::erf((split_value - mean) / scale));
+                    l = cdf * dist.n;
+                    r = dist.n - l;
+                }
+                lhs[k * num_labels + i] = l;
+                rhs[k * num_labels + i] = r;
             }
         }
-        return std::make_pair(lhs_dist, rhs_dist);
     }
 public:
-    GaussianSplitter(int n_split=10) : n_split(n_split) {}
+    GaussianSplitter(int n_split=10) : n_split(n_split) {
+        _min_per_class.fill(std::numeric_limits<double>::max());
+        _max_per_class.fill(std::numeric_limits<double>::lowest());
+    }
     void update(double att_val, int target_val, double w=1.0) {
         if (att_val < _min_per_class[target_val]) _min_per_class[target_val] = att_val;
         if (att_val > _max_per_class[target_val]) _max_per_class[target_val] = att_val;
         _att_dist_per_class[target_val].update(att_val, w);
     }
-    double cond_proba(double att_val, int target_val) {
+    double cond_proba(double att_val, int target_val) const {
         return _att_dist_per_class[target_val](att_val);
     }
-    BranchFactory<num_features, num_labels> best_evaluated_split_suggestion(const std::unordered_map<int, double>& pre_split_dist, 
-        int att_idx, double min_branch_fraction) {
+    const Gaussian& class_distribution(int target_val) const { return _att_dist_per_class[target_val]; }
+    // pre_split_entropy is InfoGainSplitCriterion::compute_entropy of the leaf distribution
+    BranchFactory<num_features, num_labels> best_evaluated_split_suggestion(double pre_split_entropy, 
+        int att_idx, double min_branch_fraction) const {
+        // scratch buffers only grow, so steady-state split attempts do not allocate
+        thread_local std::vector<double> split_values, lhs, rhs;
         BranchFactory<num_features, num_labels> best_suggestion;
-        std::vector<double> suggested_split_values = _split_point_suggestions();
-        for (const double split_value : suggested_split_values) {
-            std::pair<std::vector<double>, std::vector<double> > post_split_dist = _class_dists_from_binary_split(split_value);
-            double merit = InfoGainSplitCriterion::merit_of_split(pre_split_dist, post_split_dist, min_branch_fraction);
+        _split_point_suggestions(split_values);
+        _class_dists_from_binary_splits(split_values, lhs, rhs);
+        std::array<double, num_labels> lhs_dist, rhs_dist;
+        for (size_t k=0;k<split_values.size();k++) {
+            std::copy_n(lhs.begin() + k * num_labels, num_labels, lhs_dist.begin());
+            std::copy_n(rhs.begin() + k * num_labels, num_labels, rhs_dist.begin());
+            double merit = InfoGainSplitCriterion::merit_of_split(pre_split_entropy, lhs_dist, rhs_dist, min_branch_fraction);
             if (merit > best_suggestion.merit) {
-                best_suggestion = BranchFactory<num_features, num_labels>(merit, att_idx, split_value);
+                best_suggestion = BranchFactory<num_features, num_labels>(merit, att_idx, split_values[k]);
             }
         }
         return best_suggestion;
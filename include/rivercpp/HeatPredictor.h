@@ -64,9 +64,10 @@ private:
         item_data.last_access = ts;
     }
 public:
-    EvaluationQueue(int max_size=100, double alpha=-0.03, double heating=200.0, bool training=true)
+    // an item is hot when its heat is above the hot_rate quantile of recent heats
+    EvaluationQueue(int max_size=100, double alpha=-0.03, double heating=200.0, bool training=true, double hot_rate=0.8)
         : max_size(max_size), alpha(alpha), heating(heating), training(training), 
-        hot_list_cap(50 * max_size), hot_list(HotList(hot_list_cap)) {}
+        hot_list_cap(50 * max_size), hot_list(HotList(hot_list_cap, hot_rate)) {}
     double p80_threshold() {
         if (hot_list.length == 0) return hot_thred;
         return hot_list.get_p80_heat();
@@ -3,9 +3,21 @@
 
 # include <cmath>
 
+# include "Branch.h"
+# include "GaussianNBTable.h"
+# include "LeafPromiseIndex.h"
+# include "SlotPool.h"
+# include "ThreadPool.h"
+
 namespace rivercpp {
 template <int num_features, int num_labels>
-class BranchOrLeaf;
+class LeafNaiveBayesAdaptive;
+
+template <int num_features, int num_labels>
+class GaussianSplitter;
+
+template <int num_features, int num_labels>
+constexpr size_t leaf_slot_size();
 
 template <int num_features, int num_labels>
 class HoeffdingTree {
@@ -13,7 +25,6 @@ protected:
     int max_depth;
     bool binary_split;
     double max_size;
-    int memory_estimate_period;
     bool stop_mem_management;
 
     double _max_byte_size;
@@ -24,27 +35,65 @@ protected:
     double _size_estimate_overhead_fraction = 1.0;
     bool _growth_allowed = true;
     int _train_weight_seen_by_model = 0;
+    // splitters and naive bayes tables of this tree's leaves, freed together with the
+    // tree. A table block holds as many features as a leaf models, see _set_leaf_features
+    SlotPool _splitter_pool;
+    SlotPool _nb_pool;
+    LeafPromiseIndex<LeafNaiveBayesAdaptive<num_features, num_labels>> _promise_index;
+    // not owned, split searches over at least _parallel_split_min_features features use it
+    ThreadPool* _thread_pool = nullptr;
+    int _parallel_split_min_features = 32;
+
+    // leaves join and leave the tree, and change state, only through these so that
+    // the leaf counters and the promise index stay in step
+    NodeRef _add_leaf(LeafNaiveBayesAdaptive<num_features, num_labels>* leaf);
+    void _remove_leaf(NodeRef ref);
+    void _activate_leaf(LeafNaiveBayesAdaptive<num_features, num_labels>* leaf);
+    void _deactivate_leaf(LeafNaiveBayesAdaptive<num_features, num_labels>* leaf);
+    // for trees whose leaves model fewer than num_features features, before any leaf exists
+    void _set_leaf_features(int n) {
+        _nb_pool.set_slot_size(GaussianNBTable<num_features, num_labels>::block_bytes(n));
+        estimate_leaves();
+    }
 public:
     bool merit_preprune;
-    BranchOrLeaf<num_features, num_labels>* _root = nullptr;
+    NodeArena<LeafNaiveBayesAdaptive<num_features, num_labels>> _nodes;
+    // memory_estimate_period is ignored, the budget is checked after every sample since
+    // memory_usage() is exact; it stays so that positional arguments bind as before
     HoeffdingTree(int max_depth = 980,
         bool binary_split = false,
         double max_size = 100.0,
-        int memory_estimate_period = 1000000,
+        [[maybe_unused]] int memory_estimate_period = 1000000,
         bool stop_mem_management = false,
         bool remove_poor_attrs = false,
         bool merit_preprune = false) : 
         max_depth(max_depth),
         binary_split(binary_split),
         max_size(max_size), 
-        memory_estimate_period(memory_estimate_period),
         stop_mem_management(stop_mem_management),
         _max_byte_size(max_size * (1 << 20)),
-        merit_preprune(merit_preprune) {
+        _splitter_pool(sizeof(GaussianSplitter<num_features, num_labels>)),
+        _nb_pool(GaussianNBTable<num_features, num_labels>::block_bytes(num_features)),
+        merit_preprune(merit_preprune),
+        _nodes(leaf_slot_size<num_features, num_labels>()) {
         estimate_leaves();
     }
 
     void estimate_leaves();
+    // back to an empty tree with the same settings, reusing the node and splitter storage
+    void reset() {
+        // the index writes into the leaves, so it goes before they are dropped
+        _promise_index.clear();
+        _nodes.reset();
+        _splitter_pool.clear();
+        _nb_pool.clear();
+        _n_active_leaves = 0;
+        _n_inactive_leaves = 0;
+        _size_estimate_overhead_fraction = 1.0;
+        _growth_allowed = true;
+        _train_weight_seen_by_model = 0;
+        estimate_leaves();
+    }
 
     double _hoeffding_bound(double range_val, double confidence, double n) {
         return range_val * std::sqrt(-std::log(confidence) / (2.0 * n));
@@ -52,6 +101,24 @@ public:
 
     void _enforce_size_limit();
     void _estimate_model_size();
+
+    // Live bytes of this tree, O(1): the node tables and the pools are counted as they
+    // change. Pool chunks kept for reuse are not included, see SlotPool::bytes_reserved.
+    virtual size_t memory_usage() const {
+        return sizeof(*this) + _nodes.memory_usage() + _splitter_pool.bytes_in_use() + _nb_pool.bytes_in_use();
+    }
+    double max_byte_size() const { return _max_byte_size; }
+    // share pool between trees to evaluate split candidates of wide leaves in parallel,
+    // nullptr keeps every split search on the learning thread
+    void set_thread_pool(ThreadPool* pool, int min_features = 32) {
+        _thread_pool = pool;
+        _parallel_split_min_features = min_features;
+    }
+    ThreadPool* thread_pool() const { return _thread_pool; }
+    int parallel_split_min_features() const { return _parallel_split_min_features; }
+    // budget checked after every learn_one, the tree deactivates its least promising leaves to stay under it
+    void set_max_byte_size(double bytes) { _max_byte_size = bytes; }
+    virtual ~HoeffdingTree() = default;
 };
 }
 
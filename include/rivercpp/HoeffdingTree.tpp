@@ -11,55 +11,102 @@
 namespace rivercpp {
 template <int num_features, int num_labels>
 void HoeffdingTree<num_features, num_labels>::estimate_leaves() {
-    _active_leaf_size_estimate = estimate_leaf_memory_bytes<num_features, num_labels>();
-    _inactive_leaf_size_estimate = estimate_leaf_memory_bytes<num_features, num_labels>();
+    // until leaves have been measured, an active leaf is assumed to hold every splitter
+    _active_leaf_size_estimate = _nodes.leaf_slot_size() + num_features * _splitter_pool.get_slot_size()
+        + _nb_pool.get_slot_size();
+    _inactive_leaf_size_estimate = _nodes.leaf_slot_size();
 }
 
 template <int num_features, int num_labels>
 void HoeffdingTree<num_features, num_labels>::_enforce_size_limit() {
-    double tree_size = _size_estimate_overhead_fraction + (
-        _active_leaf_size_estimate
-        + _n_inactive_leaves * _inactive_leaf_size_estimate
-    );
-    if (_n_inactive_leaves > 0 || tree_size > _max_byte_size) {
+    if (_n_inactive_leaves > 0 || memory_usage() > _max_byte_size) {
         if (stop_mem_management) {
             _growth_allowed = false;
             return;
         }
     }
-    std::vector<LeafNaiveBayesAdaptive<num_features, num_labels>*> leaves = _root->iter_leaves();
-    std::sort(leaves.begin(), leaves.end(), [](LeafNaiveBayesAdaptive<num_features, num_labels>* a, LeafNaiveBayesAdaptive<num_features, num_labels>* b) { 
-        return a->calculate_promise() < b->calculate_promise();});
+    // the estimated size grows linearly with the number of active leaves, so the largest
+    // count that fits is solved for directly and then nudged past rounding
+    size_t n_leaves = _nodes.n_leaves();
+    auto fits = [&](size_t n_active) {
+        return (n_active * _active_leaf_size_estimate + (n_leaves - n_active) * _inactive_leaf_size_estimate)
+            * _size_estimate_overhead_fraction <= _max_byte_size;
+    };
     size_t max_active = 0;
-    while (max_active < leaves.size()) {
-        max_active++;
-        if ((max_active * _active_leaf_size_estimate + 
-            (leaves.size() - max_active) * _inactive_leaf_size_estimate)
-            * _size_estimate_overhead_fraction > _max_byte_size) {
-            max_active--;
-            break;
-        }
+    double growth = _active_leaf_size_estimate - _inactive_leaf_size_estimate;
+    if (growth > 0.0) {
+        double guess = (_max_byte_size / _size_estimate_overhead_fraction - n_leaves * _inactive_leaf_size_estimate) / growth;
+        max_active = guess <= 0.0 ? 0 : std::min(static_cast<size_t>(guess), n_leaves);
+    } else if (fits(n_leaves)) {
+        max_active = n_leaves;
     }
-    int cutoff = leaves.size() - max_active;
-    for (int i=0;i<cutoff;i++) {
-        if (leaves[i]->is_active) {
-            leaves[i]->deactivate();
-            _n_inactive_leaves++;
-            _n_active_leaves--;
-        }
+    while (max_active < n_leaves && fits(max_active + 1)) max_active++;
+    while (max_active > 0 && !fits(max_active)) max_active--;
+
+    // keep the max_active most promising leaves that may grow active, each move is O(log n)
+    while (_promise_index.n_active() > max_active) {
+        _deactivate_leaf(_promise_index.least_promising_active());
     }
-    for (size_t i=cutoff;i<leaves.size();i++) {
-        if (!leaves[i]->is_active && leaves[i]->depth < max_depth) {
-            leaves[i]->is_active = true;
-            _n_active_leaves++;
-            _n_inactive_leaves--;
-        }
+    while (_promise_index.n_active() < max_active && _promise_index.n_inactive() > 0) {
+        _activate_leaf(_promise_index.most_promising_inactive());
+    }
+    while (_promise_index.n_active() > 0 && _promise_index.n_inactive() > 0 &&
+        _promise_index.most_promising_inactive()->promise > _promise_index.least_promising_active()->promise) {
+        LeafNaiveBayesAdaptive<num_features, num_labels>* weakest = _promise_index.least_promising_active();
+        _activate_leaf(_promise_index.most_promising_inactive());
+        _deactivate_leaf(weakest);
     }
 }
 
+template <int num_features, int num_labels>
+NodeRef HoeffdingTree<num_features, num_labels>::_add_leaf(LeafNaiveBayesAdaptive<num_features, num_labels>* leaf) {
+    if (leaf->is_active) _n_active_leaves++;
+    else _n_inactive_leaves++;
+    _promise_index.insert(leaf);
+    return _nodes.add_leaf(leaf);
+}
+
+template <int num_features, int num_labels>
+void HoeffdingTree<num_features, num_labels>::_remove_leaf(NodeRef ref) {
+    LeafNaiveBayesAdaptive<num_features, num_labels>* leaf = _nodes.leaf(ref);
+    if (leaf->is_active) _n_active_leaves--;
+    else _n_inactive_leaves--;
+    _promise_index.erase(leaf);
+    _nodes.remove_leaf(ref);
+}
+
+template <int num_features, int num_labels>
+void HoeffdingTree<num_features, num_labels>::_activate_leaf(LeafNaiveBayesAdaptive<num_features, num_labels>* leaf) {
+    _promise_index.erase(leaf);
+    leaf->is_active = true;
+    _promise_index.insert(leaf);
+    _n_active_leaves++;
+    _n_inactive_leaves--;
+}
+
+// leaves at max_depth can never be reactivated and drop out of the index
+template <int num_features, int num_labels>
+void HoeffdingTree<num_features, num_labels>::_deactivate_leaf(LeafNaiveBayesAdaptive<num_features, num_labels>* leaf) {
+    _promise_index.erase(leaf);
+    leaf->deactivate();
+    if (leaf->depth < max_depth) _promise_index.insert(leaf);
+    _n_active_leaves--;
+    _n_inactive_leaves++;
+}
+
 template <int num_features, int num_labels>
 void HoeffdingTree<num_features, num_labels>::_estimate_model_size() {
-    int model_size = estimate_tree_memory_bytes<num_features, num_labels>(this);
+    // only active leaves own splitters and tables, so both leaf sizes follow from the counters
+    if (_n_active_leaves > 0) {
+        _active_leaf_size_estimate = _nodes.leaf_slot_size() + 
+            static_cast<double>(_splitter_pool.bytes_in_use() + _nb_pool.bytes_in_use()) / _n_active_leaves;
+    }
+    _inactive_leaf_size_estimate = _nodes.leaf_slot_size();
+    double model_size = memory_usage();
+    double estimated_size = _n_active_leaves * _active_leaf_size_estimate + _n_inactive_leaves * _inactive_leaf_size_estimate;
+    if (estimated_size > 0.0) {
+        _size_estimate_overhead_fraction = model_size / estimated_size;
+    }
     if (model_size > _max_byte_size) {
         _enforce_size_limit();
     }
@@ -1,10 +1,12 @@
 # ifndef HOEFFDING_TREE_CLASSIFIER_H
 # define HOEFFDING_TREE_CLASSIFIER_H
 
+# include <cstdint>
 # include <unordered_set>
 # include "Classifier.h"
 # include "TreeBase.h"
 # include "HoeffdingTree.h"
+# include "FrozenTree.h"
 
 namespace rivercpp {
 template<int num_features, int num_labels>
@@ -16,17 +18,23 @@ protected:
     double tau;
     double max_share_to_split;
     double min_branch_fraction;
+    std::vector<NodeRef> _batch_leaves;
+    // while set, due split attempts wait; the leaves keep their weight, so they are tried
+    // on the first sample after the flag is cleared
+    bool _defer_splits = false;
+    std::uint64_t _deferred_split_attempts = 0;
     
-    virtual BranchOrLeaf<num_features, num_labels>* _new_leaf(LeafNaiveBayesAdaptive<num_features, num_labels>* parent=nullptr) {
+    virtual LeafNaiveBayesAdaptive<num_features, num_labels>* _new_leaf(LeafNaiveBayesAdaptive<num_features, num_labels>* parent=nullptr) {
         int depth;
         if (parent == nullptr) {
             depth = 0;
         } else {
             depth = parent->depth + 1;
         }
-        return new LeafNaiveBayesAdaptive<num_features, num_labels>(depth);
+        return this->_nodes.template create_leaf<LeafNaiveBayesAdaptive<num_features, num_labels>>(depth, &this->_splitter_pool, &this->_nb_pool);
     }
-    void _attempt_to_split(LeafNaiveBayesAdaptive<num_features, num_labels>* leaf, NumericBinaryBranch<num_features, num_labels>* parent, int parent_branch) {
+    void _attempt_to_split(NodeRef leaf_ref, NodeRef parent, int parent_branch) {
+        LeafNaiveBayesAdaptive<num_features, num_labels>* leaf = this->_nodes.leaf(leaf_ref);
         if (!leaf->observed_class_distribution_is_pure()) {
             std::vector<BranchFactory<num_features, num_labels>> best_split_suggestions = leaf->best_split_suggestions(this, max_share_to_split, min_branch_fraction);
             std::sort(best_split_suggestions.begin(), best_split_suggestions.end());
@@ -47,79 +55,130 @@ protected:
             if (should_split) {
                 const BranchFactory<num_features, num_labels>& split_decision = best_split_suggestions[best_split_suggestions.size() - 1];
                 if (split_decision.feature < 0) {
-                    leaf->deactivate();
-                    this->_n_active_leaves--;
-                    this->_n_inactive_leaves++;
+                    this->_deactivate_leaf(leaf);
                 } else {
-                    BranchOrLeaf<num_features, num_labels>* leaves[2] = 
-                        { _new_leaf(leaf), _new_leaf(leaf) };
-                    NumericBinaryBranch<num_features, num_labels>* new_split = split_decision.assemble(leaf->stats, leaf->depth, leaves);
-                    this->_n_active_leaves++;
-                    if (parent == nullptr) {
-                        this->_root = new_split;
-                    } else {
-                        parent->children[parent_branch] = new_split;
-                    }
+                    NodeRef leaves[2] = 
+                        { this->_add_leaf(_new_leaf(leaf)), this->_add_leaf(_new_leaf(leaf)) };
+                    NodeRef new_split = this->_nodes.add_branch(split_decision.assemble(leaves));
+                    this->_nodes.replace(parent, parent_branch, new_split);
+                    this->_remove_leaf(leaf_ref);
                 }
                 this->_enforce_size_limit();
             }
         }
     }
-public:
-    HoeffdingTreeClassifier(int grace_period = 200, double delta = 1e-7, double tau = 0.05,
-        double max_share_to_split = 0.99, 
-        double min_branch_fraction = 0.01) : 
-        HoeffdingTree<num_features, num_labels>(), grace_period(grace_period), delta(delta), tau(tau),
-        max_share_to_split(max_share_to_split), min_branch_fraction(min_branch_fraction) {}
-    void learn_one(const std::vector<double>& x, int y, double w=1.0) override {
-        classes.insert(y);
-        this->_train_weight_seen_by_model += w;
-        if (!this->_root) {
-            this->_root = _new_leaf();
-            this->_n_active_leaves = 1;
-        }
-        BranchOrLeaf<num_features, num_labels>* pbnode = nullptr;
-        BranchOrLeaf<num_features, num_labels>* bnode = nullptr;
-        // find last two nodes
-        bnode = this->_root;
-        while (!bnode->is_leaf) {
-            pbnode = bnode;
-            bnode = bnode->next(x);
-        }
-        LeafNaiveBayesAdaptive<num_features, num_labels>* node = static_cast<LeafNaiveBayesAdaptive<num_features, num_labels>*>(bnode);
-        NumericBinaryBranch<num_features, num_labels>* pnode = static_cast<NumericBinaryBranch<num_features, num_labels>*>(pbnode);
+    // leaf_ref is the leaf x falls into, parent and p_branch the branch above it
+    void _learn_at(NodeRef leaf_ref, NodeRef parent, int p_branch, std::span<const double> x, int y, double w) {
+        LeafNaiveBayesAdaptive<num_features, num_labels>* node = this->_nodes.leaf(leaf_ref);
         // we assume node is always a leaf, thus no more test for multiway
         node->learn_one(x, y, w);
+        this->_promise_index.update(node);
         if (this->_growth_allowed && node->is_active) {
             if (node->depth >= this->max_depth) {
-                node->deactivate();
-                this->_n_active_leaves--;
-                this->_n_inactive_leaves++;
+                this->_deactivate_leaf(node);
             } else {
                 double weight_seen = node->total_weight();
                 double weight_diff = weight_seen - node->last_split_attempt_at;
-                if (weight_diff >= grace_period) {
-                    int p_branch = 0;
-                    if (pnode) {
-                        p_branch = pnode->branch_no(x);
-                    }
-                    _attempt_to_split(node, pnode, p_branch);
+                if (weight_diff >= grace_period && _defer_splits) {
+                    _deferred_split_attempts++;
+                } else if (weight_diff >= grace_period) {
+                    // set before attempting, a successful split frees the leaf
                     node->last_split_attempt_at = weight_seen;
+                    _attempt_to_split(leaf_ref, parent, p_branch);
                 }
             }
         }
-        if (this->_train_weight_seen_by_model % this->memory_estimate_period == 0) {
+        // the counters are exact and O(1) to read, so the budget is checked on every sample
+        if (this->memory_usage() > this->_max_byte_size) {
             this->_estimate_model_size();
         }
     }
+public:
+    HoeffdingTreeClassifier(int grace_period = 200, double delta = 1e-7, double tau = 0.05,
+        double max_share_to_split = 0.99, 
+        double min_branch_fraction = 0.01) : 
+        HoeffdingTree<num_features, num_labels>(), grace_period(grace_period), delta(delta), tau(tau),
+        max_share_to_split(max_share_to_split), min_branch_fraction(min_branch_fraction) {}
+    using Classifier::predict_proba_one;
+    int num_classes() const override { return num_labels; }
+    void reset() {
+        HoeffdingTree<num_features, num_labels>::reset();
+        classes.clear();
+    }
+    // lets a caller under time pressure postpone the expensive part of learning
+    void set_defer_splits(bool defer) { _defer_splits = defer; }
+    // samples that found a split attempt due while attempts were deferred, kept across reset
+    std::uint64_t deferred_split_attempts() const { return _deferred_split_attempts; }
+    void learn_one(std::span<const double> x, int y, double w=1.0) override {
+        classes.insert(y);
+        this->_train_weight_seen_by_model += w;
+        if (this->_nodes.empty()) {
+            this->_nodes.root = this->_add_leaf(_new_leaf());
+        }
+        // find the leaf and the branch above it
+        NodeRef parent;
+        int p_branch;
+        NodeRef leaf_ref = this->_nodes.traverse(x, parent, p_branch);
+        _learn_at(leaf_ref, parent, p_branch, x, y, w);
+    }
+    // predicts x into proba (num_labels values) and learns from the leaf it found for that,
+    // same result as predict_proba_one followed by learn_one with one traversal
+    int predict_learn_one(std::span<const double> x, int y, double w, std::span<double> proba) {
+        std::fill(proba.begin(), proba.end(), 0.0);
+        classes.insert(y);
+        this->_train_weight_seen_by_model += w;
+        // an empty tree predicts nothing
+        bool had_root = !this->_nodes.empty();
+        if (!had_root) {
+            this->_nodes.root = this->_add_leaf(_new_leaf());
+        }
+        NodeRef parent;
+        int p_branch;
+        NodeRef leaf_ref = this->_nodes.traverse(x, parent, p_branch);
+        if (had_root) {
+            this->_nodes.leaf(leaf_ref)->prediction(proba, x);
+        }
+        _learn_at(leaf_ref, parent, p_branch, x, y, w);
+        return std::distance(proba.begin(), std::max_element(proba.begin(), proba.end()));
+    }
+    int predict_learn_one(std::span<const double> x, int y, double w=1.0) override {
+        std::array<double, num_labels> proba;
+        return predict_learn_one(x, y, w, proba);
+    }
+
+    // the class set is charged per bucket and per node (value plus next pointer)
+    size_t memory_usage() const override {
+        return sizeof(*this) - sizeof(HoeffdingTree<num_features, num_labels>) + HoeffdingTree<num_features, num_labels>::memory_usage()
+            + classes.bucket_count() * sizeof(void*) + classes.size() * (sizeof(int) + sizeof(void*))
+            + _batch_leaves.capacity() * sizeof(NodeRef);
+    }
+
+    // read-only copy for serving, predicts exactly like this tree does now
+    FrozenTree<num_features, num_labels> freeze() const {
+        return FrozenTree<num_features, num_labels>(this->_nodes);
+    }
 
-    virtual std::vector<double> predict_proba_one(const std::vector<double>& x) override {
-        std::vector<double> proba(num_labels, 0.0);
-        if (this->_root) {
-            BranchOrLeaf<num_features, num_labels>* leaf = this->_root->traverse(x);
-            leaf->prediction(proba, x);
+    // proba holds num_labels values and is overwritten
+    void predict_proba_one(std::span<const double> x, std::span<double> proba) override {
+        std::fill(proba.begin(), proba.end(), 0.0);
+        if (!this->_nodes.empty()) {
+            this->_nodes.leaf(this->_nodes.traverse(x))->prediction(proba, x);
+        }
+    }
+    int predict_one(std::span<const double> x) override {
+        std::array<double, num_labels> proba;
+        predict_proba_one(x, proba);
+        return std::distance(proba.begin(), std::max_element(proba.begin(), proba.end()));
+    }
+    void predict_proba_many(std::span<const double> x, std::span<double> proba, size_t n_rows) override {
+        std::fill(proba.begin(), proba.begin() + n_rows * num_labels, 0.0);
+        if (this->_nodes.empty()) return;
+        _batch_leaves.resize(n_rows);
+        this->_nodes.traverse_many(x.data(), n_rows, num_features, _batch_leaves.data());
+        for (size_t r=0;r<n_rows;r++) {
+            this->_nodes.leaf(_batch_leaves[r])->prediction(proba.subspan(r * num_labels, num_labels), 
+                x.subspan(r * num_features, num_features));
         }
-        return proba;
     }
 };
 }
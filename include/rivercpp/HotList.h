@@ -1,61 +1,25 @@
 # ifndef HOT_LIST_H
 # define HOT_LIST_H
 
-# include <cmath>
-# include <vector>
-# include <functional>
-# include <algorithm>
+# include <cstddef>
+
+# include "QuantileSketch.h"
 
 namespace rivercpp {
+// the heat at a rank, p80 by default, over the last max_length / 2 to max_length heats,
+// so the threshold follows the stream down as well as up in fixed memory
 class HotList {
-    static constexpr double rate = 0.8;
-    std::vector<double> p80_max_heap;
-    std::vector<double> p20_min_heap;
-    int max_length;
+    double rate;
+    QuantileSketch sketch;
 public:
     int length = 0;
-    HotList(int max_length) : max_length(max_length) {}
-    double get_p80_heat() {
-        if (p80_max_heap.empty()) return 0.0;
-        return p80_max_heap[0];
-    }
+    HotList(int max_length, double rate=0.8, size_t k=128)
+        : rate(rate), sketch(k, max_length > 1 ? max_length / 2 : 1) {}
+    double get_p80_heat() const { return sketch.quantile(rate); }
+    double get_heat(double q) const { return sketch.quantile(q); }
     void insert(double heat) {
-        if (length >= max_length) {
-            // should not add new heat unless it's greater than max_heap
-            if (heat <= p80_max_heap[0]) return;
-            p80_max_heap.back() = heat;
-            std::push_heap(p80_max_heap.begin(), p80_max_heap.end(), std::less<double>());
-        } else {
-            length++;
-            int max_heap_length = std::ceil(length * rate);
-            if (max_heap_length > p80_max_heap.size()) {
-                // insert into p80_max_heap
-                if (p20_min_heap.empty() || heat <= p20_min_heap[0]) {
-                    p80_max_heap.push_back(heat);
-                    std::push_heap(p80_max_heap.begin(), p80_max_heap.end(), std::less<double>());
-                } else {
-                    // we must push it into p20 & move the least in p20 to p80
-                    p80_max_heap.push_back(p20_min_heap[0]);
-                    std::push_heap(p80_max_heap.begin(), p80_max_heap.end(), std::less<double>());
-                    std::pop_heap(p20_min_heap.begin(), p20_min_heap.end(), std::greater<double>());
-                    p20_min_heap.back() = heat;
-                    std::push_heap(p20_min_heap.begin(), p20_min_heap.end(), std::greater<double>());
-                }
-            } else {
-                // insert into p20_min_heap
-                // we assume now p80 shoule never be empty
-                if (heat >= p80_max_heap[0]) {
-                    p20_min_heap.push_back(heat);
-                    std::push_heap(p20_min_heap.begin(), p20_min_heap.end(), std::greater<double>());
-                } else {
-                    p20_min_heap.push_back(p80_max_heap[0]);
-                    std::push_heap(p20_min_heap.begin(), p20_min_heap.end(), std::greater<double>());
-                    std::pop_heap(p80_max_heap.begin(), p80_max_heap.end(), std::less<double>());
-                    p80_max_heap.back() = heat;
-                    std::push_heap(p80_max_heap.begin(), p80_max_heap.end(), std::less<double>());
-                }
-            }
-        }
+        sketch.insert(heat);
+        length = static_cast<int>(sketch.count());
     }
 };
 }
@@ -0,0 +1,64 @@
+# ifndef LATENCY_BUDGET_H
+# define LATENCY_BUDGET_H
+
+# include <algorithm>
+# include <chrono>
+# include <cstdint>
+
+namespace rivercpp {
+// Steers a shed level in [0, 1] that keeps the smoothed cost of a call near target_ns.
+// The caller reads level() before a call to decide how much work to skip and reports
+// the time the call took; the level rises in proportion to the overshoot and decays
+// again once calls are comfortably under budget. A target of 0 disables it.
+class LatencyBudget {
+private:
+    double target_ns;
+    double smoothing;
+    double gain;
+    double _ewma_ns = 0.0;
+    double _level = 0.0;
+    std::uint64_t _calls = 0;
+    std::uint64_t _over_budget = 0;
+public:
+    explicit LatencyBudget(double target_ns = 0.0, double smoothing = 0.05, double gain = 0.1)
+        : target_ns(target_ns), smoothing(smoothing), gain(gain) {}
+
+    bool enabled() const { return target_ns > 0.0; }
+    double target() const { return target_ns; }
+    double level() const { return _level; }
+    double ewma_ns() const { return _ewma_ns; }
+    std::uint64_t calls() const { return _calls; }
+    std::uint64_t over_budget() const { return _over_budget; }
+
+    void record(double ns) {
+        _calls++;
+        if (ns > target_ns) _over_budget++;
+        _ewma_ns = (_calls == 1) ? ns : _ewma_ns + smoothing * (ns - _ewma_ns);
+        double error = (_ewma_ns - target_ns) / target_ns;
+        // hold the level in a dead band just under the target instead of oscillating
+        if (error > 0.0 || error < -0.2) {
+            _level = std::clamp(_level + gain * error, 0.0, 1.0);
+        }
+    }
+
+    // times the lifetime of the scope into budget, does nothing while it is disabled
+    class Scope {
+    private:
+        LatencyBudget* budget;
+        std::chrono::steady_clock::time_point begin;
+    public:
+        explicit Scope(LatencyBudget& budget) : budget(budget.enabled() ? &budget : nullptr) {
+            if (this->budget != nullptr) begin = std::chrono::steady_clock::now();
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope() {
+            if (budget != nullptr) {
+                budget->record(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count());
+            }
+        }
+    };
+};
+}
+
+# endif
\ No newline at end of file
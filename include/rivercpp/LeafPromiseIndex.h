@@ -0,0 +1,114 @@
+# ifndef LEAF_PROMISE_INDEX_H
+# define LEAF_PROMISE_INDEX_H
+
+# include <vector>
+
+namespace rivercpp {
+// Intrusive binary heap of leaves keyed by their cached promise. Every leaf stores its
+// position in promise_slot, so a leaf can be moved or removed in O(log n).
+// Greater = false keeps the least promising leaf on top, Greater = true the most promising.
+template <class Leaf, bool Greater>
+class LeafPromiseHeap {
+private:
+    std::vector<Leaf*> heap;
+    static bool _before(const Leaf* a, const Leaf* b) {
+        return Greater ? a->promise > b->promise : a->promise < b->promise;
+    }
+    void _place(size_t pos, Leaf* leaf) {
+        heap[pos] = leaf;
+        leaf->promise_slot = pos;
+    }
+    void _sift_up(size_t pos) {
+        Leaf* leaf = heap[pos];
+        while (pos > 0) {
+            size_t parent = (pos - 1) / 2;
+            if (!_before(leaf, heap[parent])) break;
+            _place(pos, heap[parent]);
+            pos = parent;
+        }
+        _place(pos, leaf);
+    }
+    void _sift_down(size_t pos) {
+        Leaf* leaf = heap[pos];
+        size_t n = heap.size();
+        while (true) {
+            size_t child = 2 * pos + 1;
+            if (child >= n) break;
+            if (child + 1 < n && _before(heap[child + 1], heap[child])) child++;
+            if (!_before(heap[child], leaf)) break;
+            _place(pos, heap[child]);
+            pos = child;
+        }
+        _place(pos, leaf);
+    }
+public:
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+    Leaf* top() const { return heap.front(); }
+    void push(Leaf* leaf) {
+        heap.push_back(leaf);
+        _sift_up(heap.size() - 1);
+    }
+    void erase(Leaf* leaf) {
+        size_t pos = leaf->promise_slot;
+        Leaf* last = heap.back();
+        heap.pop_back();
+        leaf->promise_slot = -1;
+        if (last == leaf) return;
+        _place(pos, last);
+        update(last);
+    }
+    // restore the heap after leaf->promise changed
+    void update(Leaf* leaf) {
+        size_t pos = leaf->promise_slot;
+        _sift_up(pos);
+        _sift_down(leaf->promise_slot);
+    }
+    void clear() {
+        for (Leaf* leaf : heap) leaf->promise_slot = -1;
+        heap.clear();
+    }
+};
+
+// Leaves of one tree that take part in memory management: active leaves in a min-heap
+// (the next to deactivate) and inactive leaves that may grow again in a max-heap (the
+// next to reactivate). Leaves that may never be active again are not indexed.
+template <class Leaf>
+class LeafPromiseIndex {
+private:
+    LeafPromiseHeap<Leaf, false> active;
+    LeafPromiseHeap<Leaf, true> inactive;
+public:
+    size_t n_active() const { return active.size(); }
+    size_t n_inactive() const { return inactive.size(); }
+    Leaf* least_promising_active() const { return active.empty() ? nullptr : active.top(); }
+    Leaf* most_promising_inactive() const { return inactive.empty() ? nullptr : inactive.top(); }
+
+    // files leaf by its current is_active
+    void insert(Leaf* leaf) {
+        leaf->promise = leaf->calculate_promise();
+        if (leaf->is_active) active.push(leaf);
+        else inactive.push(leaf);
+    }
+    void erase(Leaf* leaf) {
+        if (leaf->promise_slot < 0) return;
+        if (leaf->is_active) active.erase(leaf);
+        else inactive.erase(leaf);
+    }
+    // call after the leaf learned
+    void update(Leaf* leaf) {
+        if (leaf->promise_slot < 0) return;
+        double promise = leaf->calculate_promise();
+        if (promise == leaf->promise) return;
+        leaf->promise = promise;
+        if (leaf->is_active) active.update(leaf);
+        else inactive.update(leaf);
+    }
+    void clear() {
+        active.clear();
+        inactive.clear();
+    }
+};
+}
+
+# endif
\ No newline at end of file
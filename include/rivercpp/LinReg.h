@@ -2,6 +2,7 @@
 # define LIN_REG_H
 
 # include <array>
+# include <span>
 
 # include "Regressor.h"
 
@@ -13,14 +14,14 @@ class LinearRegression : public Regressor {
 private:
     std::array<double, num_features> _weights{};
     double intercept = 0.0;
-    double _raw_dot_one(const std::vector<double>& x) const {
+    double _raw_dot_one(std::span<const double> x) const {
         double res = intercept;
         for (size_t i=0;i<num_features;i++) {
             res += x[i] * _weights[i];
         }
         return res;
     }
-    void _fit(const std::vector<double>& x, double y) {
+    void _fit(std::span<const double> x, double y) {
         double loss_gradient = (_raw_dot_one(x) - y) * 2;
         intercept -= learning_rate * loss_gradient;
         for (size_t i=0;i<num_features;i++) {
@@ -28,11 +29,11 @@ private:
         }
     }
 public:
-    void learn_one(const std::vector<double>& x, double y) override {
+    void learn_one(std::span<const double> x, double y) override {
         _fit(x, y);
     }
     // mean_func of RegressionLoss just returns y
-    double predict_one(const std::vector<double>& x) override {
+    double predict_one(std::span<const double> x) override {
         return _raw_dot_one(x);
     }
 };
@@ -20,7 +20,7 @@ public:
         sum_row[y_true] += w;
         sum_col[y_pred] += w;
     }
-    double total_true_positives() {
+    double total_true_positives() const {
         double total = 0.0;
         for (int i=0;i<num_labels;i++) {
             total += data[i][i];
@@ -37,7 +37,7 @@ public:
     void update(int y_true, int y_pred, double w=1.0) {
         cm.update(y_true, y_pred, w);
     }
-    double get() {
+    double get() const {
         if (cm.total_weight > 0.0) {
             return cm.total_true_positives() / cm.total_weight;
         } else {
@@ -0,0 +1,129 @@
+# ifndef PIPELINE_H
+# define PIPELINE_H
+
+# include <array>
+# include <concepts>
+# include <cstddef>
+# include <span>
+# include <tuple>
+# include <utility>
+
+namespace rivercpp {
+// a transformer maps num_features values onto num_features values
+template <typename T>
+concept IsTransformer = requires(T transformer, std::span<const double> x, std::span<double> out, int y) {
+    { transformer.learn_one(x, y) } -> std::same_as<void>;
+    { transformer.transform_one(x, out) } -> std::same_as<void>;
+};
+
+// a learner learns from the kind of target it predicts, a class index or a value
+template <typename M>
+concept IsLearner = requires(M model, std::span<const double> x) {
+    model.predict_one(x);
+    model.learn_one(x, model.predict_one(x));
+};
+
+template <class... Steps>
+constexpr bool is_pipeline() {
+    constexpr size_t n = sizeof...(Steps);
+    if constexpr (n == 0) {
+        return false;
+    } else {
+        return []<size_t... I>(std::index_sequence<I...>) {
+            return (IsTransformer<std::tuple_element_t<I, std::tuple<Steps...>>> && ...)
+                && IsLearner<std::tuple_element_t<n - 1, std::tuple<Steps...>>>;
+        }(std::make_index_sequence<n - 1>());
+    }
+}
+
+// one step held by value, built in place from a tuple of constructor arguments so that
+// steps which can be neither copied nor moved fit as well
+template <class T>
+struct PipelineStep {
+    T value{};
+    PipelineStep() = default;
+    template <class... Args>
+    explicit PipelineStep(std::tuple<Args...> args) : value(std::make_from_tuple<T>(std::move(args))) {}
+};
+
+// Transformers followed by one learner, composed at compile time. Every call is
+// qualified with the step's type, so nothing dispatches virtually and the compiler sees
+// the whole chain. Intermediate samples live in two stack buffers of the pipeline.
+// learn_one lets every transformer learn before it transforms, as PipelineClassifier
+// does, and predict_learn_one is predict_one followed by learn_one; only a pipeline
+// without transformers hands it to the model's fused predict_learn_one.
+template <int num_features, class... Steps>
+requires (is_pipeline<Steps...>())
+class Pipeline {
+private:
+    static constexpr size_t n_transformers = sizeof...(Steps) - 1;
+    using Model = std::tuple_element_t<n_transformers, std::tuple<Steps...>>;
+    std::tuple<PipelineStep<Steps>...> steps;
+    std::array<double, num_features> _buffers[2];
+
+    template <size_t I>
+    using Step = std::tuple_element_t<I, std::tuple<Steps...>>;
+
+    // step I writes into buffer I % 2 and reads x, the previous step's buffer
+    template <size_t I>
+    std::span<const double> _transform_step(std::span<const double> x) {
+        using T = Step<I>;
+        std::span<double> out(_buffers[I % 2]);
+        step<I>().T::transform_one(x, out);
+        return out;
+    }
+    template <size_t I, class Y>
+    void _learn_step(std::span<const double> x, Y y) {
+        using T = Step<I>;
+        step<I>().T::learn_one(x, y);
+    }
+    template <size_t... I>
+    std::span<const double> _transform(std::span<const double> x, std::index_sequence<I...>) {
+        ((x = _transform_step<I>(x)), ...);
+        return x;
+    }
+    template <class Y, size_t... I>
+    std::span<const double> _learn_transform(std::span<const double> x, Y y, std::index_sequence<I...>) {
+        ((_learn_step<I>(x, y), x = _transform_step<I>(x)), ...);
+        return x;
+    }
+public:
+    using target_type = decltype(std::declval<Model&>().predict_one(std::span<const double>()));
+
+    Pipeline() = default;
+    // one tuple of constructor arguments per step, std::tuple() for a default step
+    template <class... ArgTuples>
+    requires (sizeof...(ArgTuples) == sizeof...(Steps))
+    explicit Pipeline(std::piecewise_construct_t, ArgTuples... args) : steps(std::move(args)...) {}
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    template <size_t I>
+    Step<I>& step() { return std::get<I>(steps).value; }
+    Model& model() { return step<n_transformers>(); }
+
+    void learn_one(std::span<const double> x, target_type y) {
+        std::span<const double> z = _learn_transform(x, y, std::make_index_sequence<n_transformers>());
+        model().Model::learn_one(z, y);
+    }
+    target_type predict_one(std::span<const double> x) {
+        return model().Model::predict_one(_transform(x, std::make_index_sequence<n_transformers>()));
+    }
+    void predict_proba_one(std::span<const double> x, std::span<double> proba)
+    requires requires(Model m, std::span<const double> in, std::span<double> out) { m.predict_proba_one(in, out); } {
+        model().Model::predict_proba_one(_transform(x, std::make_index_sequence<n_transformers>()), proba);
+    }
+    target_type predict_learn_one(std::span<const double> x, target_type y) {
+        if constexpr (n_transformers == 0 
+            && requires(Model m, std::span<const double> in, target_type target) { m.predict_learn_one(in, target); }) {
+            return model().Model::predict_learn_one(x, y);
+        } else {
+            target_type y_pred = predict_one(x);
+            learn_one(x, y);
+            return y_pred;
+        }
+    }
+};
+}
+
+# endif
\ No newline at end of file
@@ -1,8 +1,6 @@
 # ifndef PIPELINE_CLASSIFIER_H
 # define PIPELINE_CLASSIFIER_H
 
-# include <stdexcept>
-
 # include "Classifier.h"
 # include "Transformer.h"
 
@@ -11,7 +9,16 @@ class PipelineClassifier : public Classifier {
 private:
     Transformer* transformer;
     Classifier* classifier;
+    // transformed sample, sized on first use
+    std::vector<double> _z;
+    std::vector<double> _batch_x;
+    std::span<const double> _transform(std::span<const double> x) {
+        _z.resize(x.size());
+        transformer->transform_one(x, _z);
+        return _z;
+    }
 public:
+    using Classifier::predict_proba_one;
     PipelineClassifier(const PipelineClassifier& other) = delete;
     PipelineClassifier& operator=(const PipelineClassifier& other) = delete;
     PipelineClassifier(Transformer* transformer, Classifier* classifier) : 
@@ -20,15 +27,34 @@ public:
         delete transformer;
         delete classifier;
     }
-    void learn_one(const std::vector<double>& x, int y, double w=1.0) override {
+    int num_classes() const override { return classifier->num_classes(); }
+    void learn_one(std::span<const double> x, int y, double w=1.0) override {
         transformer->learn_one(x, y);
-        classifier->learn_one(transformer->transform_one(x), y, w);
+        classifier->learn_one(_transform(x), y, w);
+    }
+    int predict_one(std::span<const double> x) override {
+        return classifier->predict_one(_transform(x));
+    }
+    void predict_proba_one(std::span<const double> x, std::span<double> proba) override {
+        classifier->predict_proba_one(_transform(x), proba);
     }
-    int predict_one(const std::vector<double>& x) override {
-        return classifier->predict_one(transformer->transform_one(x));
+    // same as predict_one followed by learn_one: the classifier predicts on the transform
+    // before the transformer learns from x and learns on the one after, so the two inputs
+    // differ and the classifier's fused call cannot be used
+    int predict_learn_one(std::span<const double> x, int y, double w=1.0) override {
+        int y_pred = classifier->predict_one(_transform(x));
+        learn_one(x, y, w);
+        return y_pred;
     }
-    std::vector<double> predict_proba_one(const std::vector<double>& x) override {
-        throw std::runtime_error("Prediction Proba Not Implied!");
+    void predict_proba_many(std::span<const double> x, std::span<double> proba, size_t n_rows) override {
+        if (n_rows == 0) return;
+        size_t n_cols = x.size() / n_rows;
+        _batch_x.resize(n_rows * n_cols);
+        for (size_t r=0;r<n_rows;r++) {
+            transformer->transform_one(x.subspan(r * n_cols, n_cols), 
+                std::span<double>(_batch_x).subspan(r * n_cols, n_cols));
+        }
+        classifier->predict_proba_many(_batch_x, proba, n_rows);
     }
 };
 }
@@ -1,8 +1,6 @@
 # ifndef PIPELINE_REGRESSOR_H
 # define PIPELINE_REGRESSOR_H
 
-# include <stdexcept>
-
 # include "Regressor.h"
 # include "Transformer.h"
 
@@ -11,6 +9,13 @@ class PipelineRegressor : public Regressor {
 private:
     Transformer* transformer;
     Regressor* regressor;
+    // transformed sample, sized on first use
+    std::vector<double> _z;
+    std::span<const double> _transform(std::span<const double> x) {
+        _z.resize(x.size());
+        transformer->transform_one(x, _z);
+        return _z;
+    }
 public:
     PipelineRegressor(const PipelineRegressor& other) = delete;
     PipelineRegressor& operator=(const PipelineRegressor& other) = delete;
@@ -20,12 +25,12 @@ public:
         delete transformer;
         delete regressor;
     }
-    void learn_one(const std::vector<double>& x, double y) override {
+    void learn_one(std::span<const double> x, double y) override {
         transformer->learn_one(x, y);
-        regressor->learn_one(transformer->transform_one(x), y);
+        regressor->learn_one(_transform(x), y);
     }
-    double predict_one(const std::vector<double>& x) override {
-        return regressor->predict_one(transformer->transform_one(x));
+    double predict_one(std::span<const double> x) override {
+        return regressor->predict_one(_transform(x));
     }
 };
 }
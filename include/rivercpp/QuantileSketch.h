@@ -0,0 +1,173 @@
+# ifndef QUANTILE_SKETCH_H
+# define QUANTILE_SKETCH_H
+
+# include <algorithm>
+# include <cmath>
+# include <cstddef>
+# include <iterator>
+# include <utility>
+# include <vector>
+
+namespace rivercpp {
+// Streaming quantiles in bounded memory, a hierarchy of sorted compactors in the style of
+// KLL: level h holds at most k values that stand for 2^h inserted ones each. A full level
+// keeps every other value, alternating which of each pair survives, and merges them into
+// the level above, so ranks are off by about log2(n / k) / k of n. An insert appends to
+// level 0, which is sorted once it is compacted or queried: inserts between queries cost
+// O(log k) amortized, a query pays for sorting what arrived since the last one. With a
+// window, inserts go to the newer of two generations and the older one is dropped once
+// the newer one has seen window values; answers then cover the last window to 2 * window
+// values, and once both generations have grown nothing is allocated any more.
+class QuantileSketch {
+private:
+    struct Generation {
+        std::vector<std::vector<double>> levels;
+        size_t count = 0;
+        // values at the front of level 0 that are in order, the rest arrived since
+        size_t n_sorted = 0;
+        void clear() {
+            for (std::vector<double>& level : levels) level.clear();
+            count = 0;
+            n_sorted = 0;
+        }
+    };
+    size_t k;
+    size_t window;
+    // a query sorts the level 0 being filled, which changes no answer
+    mutable Generation _generations[2];
+    int _current = 0;
+    bool _keep_odd = false;
+    mutable std::vector<double> _merged;
+    // every value but those on the level 0 being filled, sorted, with the total weight up
+    // to and including it. Only compactions and rotations change it, a query rebuilds it
+    mutable std::vector<std::pair<double, double>> _summary;
+    mutable bool _summary_stale = false;
+
+    // sorts the values appended to level 0 and merges them into the sorted front from the
+    // back, so only front values above the smallest new one move
+    void _sort_level0(Generation& generation) const {
+        std::vector<double>& level = generation.levels[0];
+        if (generation.n_sorted == level.size()) return;
+        auto middle = level.begin() + generation.n_sorted;
+        std::sort(middle, level.end());
+        if (generation.n_sorted > 0 && *middle < *std::prev(middle)) {
+            _merged.assign(middle, level.end());
+            auto front = middle;
+            auto out = level.end();
+            for (auto appended = _merged.end();appended != _merged.begin();) {
+                if (front != level.begin() && *std::prev(front) > *std::prev(appended)) *--out = *--front;
+                else *--out = *--appended;
+            }
+        }
+        generation.n_sorted = level.size();
+    }
+    void _compact(Generation& generation, size_t h) {
+        if (generation.levels.size() == h + 1) {
+            generation.levels.emplace_back();
+            generation.levels.back().reserve(2 * k);
+        }
+        std::vector<double>& level = generation.levels[h];
+        std::vector<double>& above = generation.levels[h + 1];
+        // an odd value out stays, the largest so the level remains sorted
+        size_t n_pairs = level.size() / 2;
+        size_t offset = _keep_odd ? 1 : 0;
+        _keep_odd = !_keep_odd;
+        _merged.clear();
+        size_t j = 0;
+        for (size_t i=0;i<n_pairs;i++) {
+            double survivor = level[2 * i + offset];
+            for (;j<above.size() && above[j] <= survivor;j++) _merged.push_back(above[j]);
+            _merged.push_back(survivor);
+        }
+        for (;j<above.size();j++) _merged.push_back(above[j]);
+        above.swap(_merged);
+        level.erase(level.begin(), level.begin() + 2 * n_pairs);
+        if (h == 0) generation.n_sorted = level.size();
+        _summary_stale = true;
+        if (above.size() >= k) _compact(generation, h + 1);
+    }
+    void _rebuild_summary() const {
+        _summary.clear();
+        for (int g=0;g<2;g++) {
+            const std::vector<std::vector<double>>& levels = _generations[g].levels;
+            double weight = 1.0;
+            for (size_t h=0;h<levels.size();h++, weight*=2.0) {
+                if (g == _current && h == 0) continue;
+                for (double value : levels[h]) _summary.emplace_back(value, weight);
+            }
+        }
+        std::sort(_summary.begin(), _summary.end());
+        double total = 0.0;
+        for (auto& [value, weight] : _summary) weight = (total += weight);
+        _summary_stale = false;
+    }
+    // total weight of the summary up to and including value
+    double _summary_rank(double value) const {
+        auto it = std::upper_bound(_summary.begin(), _summary.end(), value,
+            [](double v, const std::pair<double, double>& entry) { return v < entry.first; });
+        return it == _summary.begin() ? 0.0 : std::prev(it)->second;
+    }
+public:
+    // k is rounded up to an even number of at least 2, window 0 keeps the whole stream
+    explicit QuantileSketch(size_t k=128, size_t window=0)
+        : k(std::max<size_t>(2, k + k % 2)), window(window) {
+        for (Generation& generation : _generations) {
+            generation.levels.emplace_back();
+            generation.levels.back().reserve(this->k + 1);
+        }
+        _merged.reserve(2 * this->k);
+        _summary.reserve(2 * this->k);
+    }
+
+    // values the answers cover
+    size_t count() const { return _generations[0].count + _generations[1].count; }
+
+    void insert(double value) {
+        if (window > 0 && _generations[_current].count >= window) {
+            _current ^= 1;
+            _generations[_current].clear();
+            _summary_stale = true;
+        }
+        Generation& generation = _generations[_current];
+        std::vector<double>& level = generation.levels[0];
+        level.push_back(value);
+        generation.count++;
+        if (level.size() >= k) {
+            _sort_level0(generation);
+            _compact(generation, 0);
+        }
+    }
+
+    // smallest value whose rank reaches ceil(q * count()), 0 while the sketch is empty.
+    // Ranks only grow with the value, so the answer is the first value reaching the
+    // target in the summary or in the level being filled, found by two binary searches
+    double quantile(double q) const {
+        size_t n = count();
+        if (n == 0) return 0.0;
+        if (_summary_stale) _rebuild_summary();
+        _sort_level0(_generations[_current]);
+        const std::vector<double>& live = _generations[_current].levels[0];
+        double target = std::max(1.0, std::ceil(std::clamp(q, 0.0, 1.0) * n));
+        auto live_rank = [&](double value) {
+            return double(std::upper_bound(live.begin(), live.end(), value) - live.begin());
+        };
+        auto in_summary = std::partition_point(_summary.begin(), _summary.end(),
+            [&](const std::pair<double, double>& entry) { return entry.second + live_rank(entry.first) < target; });
+        auto in_live = std::partition_point(live.begin(), live.end(),
+            [&](double value) { return live_rank(value) + _summary_rank(value) < target; });
+        if (in_summary == _summary.end()) return *in_live;
+        if (in_live == live.end()) return in_summary->first;
+        return std::min(in_summary->first, *in_live);
+    }
+
+    void clear() {
+        for (Generation& generation : _generations) generation.clear();
+        _current = 0;
+        _keep_odd = false;
+        _summary.clear();
+        _summary_stale = false;
+    }
+};
+}
+
+# endif
\ No newline at end of file
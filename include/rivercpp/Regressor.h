@@ -1,13 +1,21 @@
 # ifndef REGRESSOR_H
 # define REGRESSOR_H
 
+# include <span>
 # include <vector>
 
 namespace rivercpp {
+// x is read in place, the std::vector overloads forward to the span forms
 class Regressor {
 public:
-    virtual void learn_one(const std::vector<double>& x, double y) = 0;
-    virtual double predict_one(const std::vector<double>& x) = 0;
+    virtual void learn_one(std::span<const double> x, double y) = 0;
+    virtual double predict_one(std::span<const double> x) = 0;
+    virtual void learn_one(const std::vector<double>& x, double y) {
+        learn_one(std::span<const double>(x), y);
+    }
+    virtual double predict_one(const std::vector<double>& x) {
+        return predict_one(std::span<const double>(x));
+    }
     virtual ~Regressor() = default;
 };
 }
@@ -0,0 +1,116 @@
+# ifndef SLOT_POOL_H
+# define SLOT_POOL_H
+
+# include <algorithm>
+# include <cassert>
+# include <cstddef>
+# include <new>
+# include <type_traits>
+# include <utility>
+# include <vector>
+
+namespace rivercpp {
+// Fixed-size slot allocator owned by a single tree. Slots are carved from chunks that
+// double in size, released slots are threaded through an intrusive free list and reused
+// first, and release() hands every chunk back at once while clear() keeps them for the
+// next objects. Destructors are never run, so only trivially destructible objects may
+// live here.
+class SlotPool {
+private:
+    static constexpr size_t first_chunk_slots = 8;
+    static constexpr size_t max_chunk_slots = 4096;
+
+    size_t slot_size;
+    size_t slot_align;
+    std::vector<std::byte*> chunks;
+    // chunks[i] holds _chunk_slots(i) slots, chunks from used_chunks on are kept by clear()
+    size_t used_chunks = 0;
+    std::byte* cursor = nullptr;
+    std::byte* chunk_end = nullptr;
+    size_t next_chunk_slots = first_chunk_slots;
+    void* free_list = nullptr;
+    // byte counters, kept current by every allocate, deallocate and new chunk
+    size_t _bytes_in_use = 0;
+    size_t _bytes_reserved = 0;
+
+    void _new_chunk() {
+        size_t bytes = next_chunk_slots * slot_size;
+        if (used_chunks == chunks.size()) {
+            chunks.push_back(static_cast<std::byte*>(::operator new(bytes, std::align_val_t(slot_align))));
+            _bytes_reserved += bytes;
+        }
+        cursor = chunks[used_chunks++];
+        chunk_end = cursor + bytes;
+        next_chunk_slots = std::min(next_chunk_slots * 2, max_chunk_slots);
+    }
+public:
+    SlotPool(size_t slot_size, size_t slot_align = alignof(std::max_align_t)) : slot_align(slot_align) {
+        set_slot_size(slot_size);
+    }
+    SlotPool(const SlotPool&) = delete;
+    SlotPool& operator=(const SlotPool&) = delete;
+    ~SlotPool() { release(); }
+
+    size_t get_slot_size() const { return slot_size; }
+    // drops every object and returns the chunks, later slots have the new size
+    void set_slot_size(size_t slot_size) {
+        release();
+        // a free slot stores the next free slot in place
+        slot_size = std::max(slot_size, sizeof(void*));
+        this->slot_size = (slot_size + slot_align - 1) / slot_align * slot_align;
+    }
+    // bytes of live objects
+    size_t bytes_in_use() const { return _bytes_in_use; }
+    // bytes taken from the global allocator, live or on the free list
+    size_t bytes_reserved() const { return _bytes_reserved; }
+
+    void* allocate() {
+        _bytes_in_use += slot_size;
+        if (free_list != nullptr) {
+            void* slot = free_list;
+            free_list = *static_cast<void**>(slot);
+            return slot;
+        }
+        if (cursor == chunk_end) _new_chunk();
+        void* slot = cursor;
+        cursor += slot_size;
+        return slot;
+    }
+    void deallocate(void* slot) {
+        _bytes_in_use -= slot_size;
+        *static_cast<void**>(slot) = free_list;
+        free_list = slot;
+    }
+
+    template <class T, class... Args>
+    T* create(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "SlotPool never runs destructors");
+        assert(sizeof(T) <= slot_size && alignof(T) <= slot_align && "SlotPool::create(): object does not fit a slot");
+        return new (allocate()) T(std::forward<Args>(args)...);
+    }
+
+    // drops every object at once, the chunks stay reserved and are refilled in order
+    void clear() {
+        used_chunks = 0;
+        cursor = chunk_end = nullptr;
+        next_chunk_slots = first_chunk_slots;
+        free_list = nullptr;
+        _bytes_in_use = 0;
+    }
+    // drops every object at once and returns the chunks
+    void release() {
+        for (std::byte* chunk : chunks) {
+            ::operator delete(chunk, std::align_val_t(slot_align));
+        }
+        chunks.clear();
+        used_chunks = 0;
+        cursor = chunk_end = nullptr;
+        next_chunk_slots = first_chunk_slots;
+        free_list = nullptr;
+        _bytes_in_use = 0;
+        _bytes_reserved = 0;
+    }
+};
+}
+
+# endif
\ No newline at end of file
@@ -6,6 +6,7 @@
 # include <cmath>
 # include <vector>
 # include <array>
+# include <span>
 
 namespace rivercpp {
 // always with_std
@@ -16,7 +17,8 @@ private:
     std::array<double, num_features> means;
     std::array<double, num_features> vars;
 public:
-    void learn_one(const std::vector<double>& x, int y) override {
+    using Transformer::transform_one;
+    void learn_one(std::span<const double> x, int y) override {
         for (size_t i=0;i<x.size();i++) {
             counts[i] += 1;
             double old_mean = means[i];
@@ -24,12 +26,11 @@ public:
             vars[i] += ((x[i] - old_mean) * (x[i] - means[i]) - vars[i]) / counts[i];
         }
     }
-    std::vector<double> transform_one(const std::vector<double>& x) override {
-        std::vector<double> res(x.size(), 0.0);
+    // out may alias x
+    void transform_one(std::span<const double> x, std::span<double> out) override {
         for (size_t i=0;i<x.size();i++) {
-            res[i] = vars[i] > 0.0 ? (x[i] - means[i]) / std::sqrt(vars[i]) : 0.0;
+            out[i] = vars[i] > 0.0 ? (x[i] - means[i]) / std::sqrt(vars[i]) : 0.0;
         }
-        return res;
     }
 };
 }
@@ -0,0 +1,109 @@
+# ifndef THREAD_POOL_H
+# define THREAD_POOL_H
+
+# include <algorithm>
+# include <atomic>
+# include <condition_variable>
+# include <cstdint>
+# include <mutex>
+# include <thread>
+# include <type_traits>
+# include <vector>
+
+namespace rivercpp {
+// Persistent worker threads for data-parallel loops. parallel_for hands indices out
+// through an atomic counter and the calling thread takes indices as well, so a pool
+// of size n runs n - 1 workers. One loop runs at a time; a parallel_for issued from
+// inside a loop body runs inline on the thread that issued it.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex submit_mutex;
+    std::mutex m;
+    std::condition_variable cv_work;
+    std::condition_variable cv_done;
+    std::uint64_t generation = 0;
+    size_t pending = 0;
+    bool stop = false;
+
+    // current loop, type-erased
+    void (*job_fn)(void*, size_t) = nullptr;
+    void* job_ctx = nullptr;
+    size_t job_n = 0;
+    std::atomic<size_t> next{0};
+
+    static bool& _in_loop() {
+        thread_local bool in_loop = false;
+        return in_loop;
+    }
+    void _run_indices() {
+        bool& in_loop = _in_loop();
+        in_loop = true;
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < job_n;
+            i = next.fetch_add(1, std::memory_order_relaxed)) {
+            job_fn(job_ctx, i);
+        }
+        in_loop = false;
+    }
+    void _worker_loop() {
+        std::uint64_t seen = 0;
+        while (true) {
+            std::unique_lock<std::mutex> lock(m);
+            cv_work.wait(lock, [&] { return stop || generation != seen; });
+            if (stop) return;
+            seen = generation;
+            lock.unlock();
+            _run_indices();
+            lock.lock();
+            if (--pending == 0) cv_done.notify_one();
+        }
+    }
+public:
+    // n_threads counts the caller, 0 means one per hardware thread
+    explicit ThreadPool(unsigned n_threads = 0) {
+        if (n_threads == 0) n_threads = std::max(1u, std::thread::hardware_concurrency());
+        workers.reserve(n_threads - 1);
+        for (unsigned i=1;i<n_threads;i++) {
+            workers.emplace_back([this] { _worker_loop(); });
+        }
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stop = true;
+        }
+        cv_work.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    size_t size() const { return workers.size() + 1; }
+
+    // calls f(i) for every i in [0, n), returns when all calls are done
+    template <class F>
+    void parallel_for(size_t n, F&& f) {
+        if (n == 0) return;
+        if (workers.empty() || n == 1 || _in_loop()) {
+            for (size_t i=0;i<n;i++) f(i);
+            return;
+        }
+        std::lock_guard<std::mutex> submit(submit_mutex);
+        {
+            std::lock_guard<std::mutex> lock(m);
+            job_fn = [](void* ctx, size_t i) { (*static_cast<std::remove_reference_t<F>*>(ctx))(i); };
+            job_ctx = const_cast<void*>(static_cast<const void*>(&f));
+            job_n = n;
+            next.store(0, std::memory_order_relaxed);
+            pending = workers.size();
+            generation++;
+        }
+        cv_work.notify_all();
+        _run_indices();
+        std::unique_lock<std::mutex> lock(m);
+        cv_done.wait(lock, [&] { return pending == 0; });
+    }
+};
+}
+
+# endif
\ No newline at end of file
@@ -1,13 +1,25 @@
 # ifndef TRANSFORMER_H
 # define TRANSFORMER_H
 
+# include <span>
 # include <vector>
 
 namespace rivercpp {
 class Transformer {
 public:
-    virtual void learn_one(const std::vector<double>& x, int y) = 0;
-    virtual std::vector<double> transform_one(const std::vector<double>& x) = 0;
+    virtual void learn_one(std::span<const double> x, int y) = 0;
+    // out holds x.size() values and is overwritten
+    virtual void transform_one(std::span<const double> x, std::span<double> out) = 0;
+    // the std::vector overloads forward to the span forms, the allocating one is brought
+    // into derived classes with a using-declaration
+    virtual void learn_one(const std::vector<double>& x, int y) {
+        learn_one(std::span<const double>(x), y);
+    }
+    virtual std::vector<double> transform_one(const std::vector<double>& x) {
+        std::vector<double> res(x.size(), 0.0);
+        transform_one(std::span<const double>(x), res);
+        return res;
+    }
     virtual ~Transformer() = default;
 };
 }
@@ -3,8 +3,8 @@
 
 # include "TreeBase.h"
 
+# include <cassert>
 # include <vector>
-# include <queue>
 # include <algorithm>
 
 # include "HoeffdingTree.h"
@@ -27,17 +27,32 @@ std::vector<BranchFactory<num_features, num_labels> > LeafNaiveBayesAdaptive<num
             BranchFactory<num_features, num_labels> null_split;
             best_suggestions.push_back(null_split);
         }
+        double pre_split_entropy = InfoGainSplitCriterion::compute_entropy(this->stats);
+        std::array<int, num_features> features;
+        int n_features = 0;
         for (int i=0;i<num_features;i++) {
-            if (splitters[i] != nullptr) {
-                best_suggestions.push_back(splitters[i]->best_evaluated_split_suggestion(this->stats, i, min_branch_fraction));
-            }
+            if (splitters[i] != nullptr) features[n_features++] = i;
+        }
+        // wide leaves are evaluated on the tree's pool, every feature into its own slot
+        std::array<BranchFactory<num_features, num_labels>, num_features> evaluated;
+        ThreadPool* pool = tree->thread_pool();
+        bool parallel = pool != nullptr && n_features >= tree->parallel_split_min_features();
+        if (parallel) {
+            pool->parallel_for(n_features, [&](size_t k) {
+                evaluated[k] = splitters[features[k]]->best_evaluated_split_suggestion(pre_split_entropy, features[k], min_branch_fraction);
+            });
+        }
+        // suggestions are collected in feature order either way, so results do not depend on threads
+        for (int k=0;k<n_features;k++) {
+            best_suggestions.push_back(parallel ? evaluated[k] : 
+                splitters[features[k]]->best_evaluated_split_suggestion(pre_split_entropy, features[k], min_branch_fraction));
         }
     }
     return best_suggestions;
 }
 
 template <int num_features, int num_labels>
-double LeafNaiveBayesAdaptive<num_features, num_labels>::calculate_promise() {
+double LeafNaiveBayesAdaptive<num_features, num_labels>::calculate_promise() const {
     double total_seen = sum(this->stats);
     if (total_seen > 0.0) {
         return total_seen - max_value(this->stats);
@@ -50,42 +65,59 @@ void LeafNaiveBayesAdaptive<num_features, num_labels>::deactivate() {
     is_active = false;
     for (int i=0;i<num_features;i++) {
         if (splitters[i] != nullptr) {
-            delete splitters[i];
+            _splitter_pool->deallocate(splitters[i]);
             splitters[i] = nullptr;
         }
     }
+    if (!_nb_table.empty()) _nb_pool->deallocate(_nb_table.release());
 }
 
 template <int num_features, int num_labels>
-void LeafNaiveBayesAdaptive<num_features, num_labels>::update_splitters(const std::vector<double>& x, int y, double w) {
-    for (size_t i=0;i<x.size();i++) {
-        if (splitters[i] == nullptr) {
-            // should copy from saved splitter but we'll just let go
-            splitters[i] = new GaussianSplitter<num_features, num_labels>(i);
-        }
-        splitters[i]->update(x[i], y, w);
+void LeafNaiveBayesAdaptive<num_features, num_labels>::_take_nb_table(const int* features, int n) {
+    assert((GaussianNBTable<num_features, num_labels>::block_bytes(n) <= _nb_pool->get_slot_size()) 
+        && "naive bayes table does not fit the tree's nb_pool");
+    _nb_table.assign(_nb_pool->allocate(), features, n);
+}
+
+template <int num_features, int num_labels>
+void LeafNaiveBayesAdaptive<num_features, num_labels>::_update_splitter(int slot, int feature, double att_val, int y, double w) {
+    if (splitters[feature] == nullptr) {
+        // should copy from saved splitter but we'll just let go
+        splitters[feature] = _splitter_pool->create<GaussianSplitter<num_features, num_labels>>(feature);
     }
+    splitters[feature]->update(att_val, y, w);
+    _nb_table.set(slot, y, splitters[feature]->class_distribution(y));
 }
 
 template <int num_features, int num_labels>
-void LeafNaiveBayesAdaptive<num_features, num_labels>::prediction(std::vector<double>& proba, const std::vector<double>& x) {
-    if (is_active && _nb_correct_weight >= _mc_correct_weight) {
-       do_naive_bayes_prediction<num_features, num_labels>(proba, x, this->stats, splitters);
+void LeafNaiveBayesAdaptive<num_features, num_labels>::update_splitters(std::span<const double> x, int y, double w) {
+    static constexpr std::array<int, num_features> features = feature_array<num_features>();
+    if (_nb_table.empty()) _take_nb_table(features.data(), num_features);
+    for (int i=0;i<num_features;i++) {
+        _update_splitter(i, i, x[i], y, w);
+    }
+}
+
+template <int num_features, int num_labels>
+void LeafNaiveBayesAdaptive<num_features, num_labels>::prediction(std::span<double> proba, std::span<const double> x) {
+    if (predicts_with_naive_bayes()) {
+       do_naive_bayes_prediction<num_features, num_labels>(proba, x, this->stats, _nb_table);
     } else {
         normalize_values_in_dict(proba, this->stats);
     }
 }
 
 template <int num_features, int num_labels>
-void LeafNaiveBayesAdaptive<num_features, num_labels>::learn_one(const std::vector<double>& x, int y, double w) {
+void LeafNaiveBayesAdaptive<num_features, num_labels>::learn_one(std::span<const double> x, int y, double w) {
     if(is_active) {
-        std::vector<double> mc_pred(num_labels, 0.0);
+        std::array<double, num_labels> mc_pred{};
         normalize_values_in_dict(mc_pred, this->stats);
-        if (this->stats.size() == 0 || max_index(mc_pred) == y) {
+        if (sum(this->stats) == 0.0 || max_index(mc_pred) == y) {
             _mc_correct_weight += w;
         }
-        std::vector<double> nb_pred(num_labels, -1.0);
-        do_naive_bayes_prediction<num_features, num_labels>(nb_pred, x, this->stats, splitters);
+        std::array<double, num_labels> nb_pred;
+        nb_pred.fill(-1.0);
+        do_naive_bayes_prediction<num_features, num_labels>(nb_pred, x, this->stats, _nb_table);
         if (max_index(nb_pred) == y) {
             _nb_correct_weight += w;
         }
@@ -98,77 +130,11 @@ void LeafNaiveBayesAdaptive<num_features, num_labels>::learn_one(const std::vect
 }
 
 template <int num_features, int num_labels>
-int estimate_tree_memory_bytes(HoeffdingTree<num_features, num_labels>* tree) {
-    int total = 0;
-    // this
-    total += sizeof(HoeffdingTreeClassifier<num_features, num_labels>);
-    // classifier-classes
-    total += num_features * sizeof(int);
-    // root
-    std::queue<BranchOrLeaf<num_features, num_labels>*> q;
-    q.push(tree->_root);
-    while (!q.empty()) {
-        BranchOrLeaf<num_features, num_labels>* b = q.front();
-        q.pop();
-        if (b->is_leaf) {
-            total += estimate_leaf_memory_bytes<num_features, num_labels>();
-        } else {
-            total += estimate_branch_memory_bytes<num_features, num_labels>();
-            NumericBinaryBranch<num_features, num_labels>* branch = static_cast<NumericBinaryBranch<num_features, num_labels>*>(b);
-            q.push(branch->children[0]);
-            q.push(branch->children[1]);
-        }
-    }
-    return total;
-}
-
-template <int num_features, int num_labels>
-constexpr int estimate_branch_memory_bytes() {
-    int total = 0;
-    // this
-    total += sizeof(NumericBinaryBranch<num_features, num_labels>);
-    // stats
-    total += num_features * (sizeof(int) + sizeof(double));
-
-    return total;
-}
-
-template <int num_features, int num_labels>
-constexpr int estimate_leaf_memory_bytes() {
-    int total = 0;
-
-    // this
-    total += sizeof(LeafNaiveBayesAdaptive<num_features, num_labels>);
-
-    // splitters
-    total += num_features * sizeof(GaussianSplitter<num_features, num_labels>*);
-
-    // splitters
-    const int szGaussian = sizeof(Gaussian);
-    int s = 0;
-    s += sizeof(GaussianSplitter<num_features, num_labels>);
-    s += num_labels * szGaussian;
-    s += num_labels * sizeof(double);
-    s += num_labels * sizeof(double);
-    total += s * num_features;
-
-    // stats
-    total += num_features * (sizeof(int) + sizeof(double));
-
-    return total;
-}
-
-template <int num_features, int num_labels>
-void RandomLeafNaiveBayesAdaptive<num_features, num_labels>::update_splitters(const std::vector<double>& x, int y, double w) {
-    if (feature_indices.size() == 0) {
-        _sample_features(feature_indices, max_features);
-    }
-    for (size_t i=0;i<feature_indices.size();i++) {
-        if (this->splitters[i] == nullptr) {
-            // should copy from saved splitter but we'll just let go
-            this->splitters[i] = new GaussianSplitter<num_features, num_labels>(i);
-        }
-        this->splitters[i]->update(x[i], y, w);
+void RandomLeafNaiveBayesAdaptive<num_features, num_labels>::update_splitters(std::span<const double> x, int y, double w) {
+    if (this->_nb_table.empty()) this->_take_nb_table(feature_indices.data(), n_feature_indices);
+    for (int i=0;i<n_feature_indices;i++) {
+        int feature = feature_indices[i];
+        this->_update_splitter(i, feature, x[feature], y, w);
     }
 }
 }
@@ -1,32 +1,45 @@
 # ifndef ADWIN_H
 # define ADWIN_H
 
+# include <algorithm>
 # include <cmath>
-# include <vector>
-# include <deque>
+# include <iterator>
 
 namespace rivercpp {
-template <int max_size>
-class Bucket {
+// Exponential histogram of ADWIN in one flat block: row r holds up to max_buckets + 1
+// buckets of 2^r elements each as a ring, oldest bucket at head[r]. Rows past the last
+// one in use are empty, so nothing is allocated after construction.
+template <int max_buckets>
+class BucketRows {
 public:
-    std::vector<double> total_array = std::vector<double>(max_size+1);
-    std::vector<double> variance_array = std::vector<double>(max_size+1);
-    int current_idx=0;
-    void insert_data(double value, double variance) {
-        total_array[current_idx] = value;
-        variance_array[current_idx] = variance;
-        current_idx++;
+    // width is an int, so a bucket of 2^31 elements never forms
+    static constexpr int max_rows = 32;
+    static constexpr int capacity = max_buckets + 1;
+    double totals[max_rows][capacity] = {};
+    double variances[max_rows][capacity] = {};
+    int head[max_rows] = {};
+    int count[max_rows] = {};
+    // k-th oldest bucket of a row
+    int slot(int row, int k) const {
+        int i = head[row] + k;
+        return (i >= capacity) ? i - capacity : i;
     }
-    void compress(int n_elements) {
-        for (int i=n_elements;i<=max_size;i++) {
-            total_array[i-n_elements] = total_array[i];
-            variance_array[i-n_elements] = variance_array[i];
-        }
-        for (int i=max_size-n_elements+1;i<=max_size;i++) {
-            total_array[i] = 0.0;
-            variance_array[i] = 0.0;
-        }
-        current_idx -= n_elements;
+    double total(int row, int k) const { return totals[row][slot(row, k)]; }
+    double variance(int row, int k) const { return variances[row][slot(row, k)]; }
+    void push(int row, double value, double variance) {
+        int i = slot(row, count[row]);
+        totals[row][i] = value;
+        variances[row][i] = variance;
+        count[row]++;
+    }
+    // drops the n oldest buckets of a row
+    void pop(int row, int n) {
+        head[row] = slot(row, n);
+        count[row] -= n;
+    }
+    void clear() {
+        std::fill(std::begin(head), std::end(head), 0);
+        std::fill(std::begin(count), std::end(count), 0);
     }
 };
 
@@ -34,8 +47,9 @@ template <int max_buckets=5>
 class AdaptiveWindowing {
 public:
 //private:
-    std::deque<Bucket<max_buckets>*> bucket_deque = 
-        std::deque<Bucket<max_buckets>*>(1, new Bucket<max_buckets>());
+    BucketRows<max_buckets> rows;
+    // rows in use, row 0 counts even while it is empty
+    int n_rows = 1;
     double delta;
     double total = 0.0;
     double variance = 0.0;
@@ -50,47 +64,28 @@ public:
     int n_detections = 0;
     inline int _calculate_bucket_size (int row) { return 1 << row;}
     void _compress_buckets() {
-        Bucket<max_buckets>* bucket = bucket_deque[0];
-        Bucket<max_buckets>* next_bucket = nullptr;
-        int idx = 0;
-        while (bucket) {
-            int k = bucket->current_idx;
-            if (k == max_buckets+1) {
-                if (static_cast<size_t>(idx + 1) < bucket_deque.size()) {
-                    next_bucket = bucket_deque[idx+1];
-                } else {
-                    next_bucket = new Bucket<max_buckets>();
-                    bucket_deque.push_back(next_bucket);
-                }
-                int n1 = _calculate_bucket_size(idx);
-                int n2 = _calculate_bucket_size(idx);
-                double mu1 = bucket->total_array[0] / n1;
-                double mu2 = bucket->total_array[1] / n2;
-
-                double total12 = bucket->total_array[0] + bucket->total_array[1];
-                double temp = n1 * n2 * (mu1 - mu2) * (mu1 - mu2) / (n1 + n2);
-                double v12 = bucket->variance_array[0] + bucket->variance_array[1] + temp;
-                next_bucket->insert_data(total12, v12);
-                n_buckets++;
-                bucket->compress(2);
-
-                if (next_bucket->current_idx <= max_buckets) {
-                    break;
-                }
-            } else {
+        for (int idx=0;idx<n_rows;idx++) {
+            if (rows.count[idx] != max_buckets+1) {
                 break;
             }
-            if (static_cast<size_t>(idx + 1) < bucket_deque.size()) {
-                bucket = bucket_deque[idx+1];
-            } else {
-                bucket = nullptr;
+            if (idx + 1 == n_rows) {
+                n_rows++;
             }
-            idx++;
+            int n1 = _calculate_bucket_size(idx);
+            int n2 = _calculate_bucket_size(idx);
+            double mu1 = rows.total(idx, 0) / n1;
+            double mu2 = rows.total(idx, 1) / n2;
+
+            double total12 = rows.total(idx, 0) + rows.total(idx, 1);
+            double temp = n1 * n2 * (mu1 - mu2) * (mu1 - mu2) / (n1 + n2);
+            double v12 = rows.variance(idx, 0) + rows.variance(idx, 1) + temp;
+            rows.push(idx + 1, total12, v12);
+            n_buckets++;
+            rows.pop(idx, 2);
         }
     }
     void _insert_element(double value, double variance) {
-        Bucket<max_buckets>* bucket = bucket_deque[0];
-        bucket->insert_data(value, variance);
+        rows.push(0, value, variance);
         n_buckets++;
 
         if (n_buckets > max_n_buckets) {
@@ -108,12 +103,10 @@ public:
 
         _compress_buckets();
     }
-    int _delete_element() {
-        Bucket<max_buckets>* bucket = bucket_deque[bucket_deque.size()-1];
-        int n = _calculate_bucket_size(bucket_deque.size()-1);
-        double u = bucket->total_array[0];
+    // window statistics without the oldest bucket, of n elements summing to u with
+    // variance v; the bucket itself leaves the rows in _drop_oldest
+    void _delete_element(int n, double u, double v) {
         double mu = u / n;
-        double v = bucket->variance_array[0];
 
         width -= n;
         total -= u;
@@ -121,84 +114,81 @@ public:
         double increment_variance = v + n * width * (mu - mu_window) * (mu - mu_window) / (n + width);
         variance -= increment_variance;
 
-        bucket->compress(1);
         n_buckets--;
-
-        if (bucket->current_idx == 0) {
-            delete bucket_deque.back();
-            bucket_deque.pop_back();
+    }
+    // pops the n_dropped oldest buckets, last row first
+    void _drop_oldest(int n_dropped) {
+        while (n_dropped > 0) {
+            int row = n_rows - 1;
+            int n = std::min(n_dropped, rows.count[row]);
+            rows.pop(row, n);
+            n_dropped -= n;
+            if (rows.count[row] == 0) {
+                n_rows--;
+            }
         }
-        
-        return n;
     }
-    bool _evaluate_cut(double n0, double n1, double delta_mean, double delta) {
-        double delta_prime = std::log(2 * std::log(width) / delta);
+    bool _evaluate_cut(double n0, double n1, double delta_mean, double delta_prime) {
         double m_recip = (1.0 / (n0 - min_window_length + 1)) + (1.0 / (n1 - min_window_length + 1));
         double epsilon = std::sqrt(2 * m_recip * variance / width * delta_prime) + 2.0 / 3.0 * delta_prime * m_recip;
-        return (std::abs(delta_mean) > epsilon);
+        return (n1 >= min_window_length) && (n0 >= min_window_length) && (std::abs(delta_mean) > epsilon);
     }
+    // Every bucket boundary is a candidate cut between an older part of n0 elements and a
+    // newer one of n1. While a candidate that passes the test exists, the oldest bucket
+    // leaves the window and the candidates are evaluated again against the smaller window.
+    // A pass sums the buckets from the oldest one left, oldest first, exactly as a scan
+    // over the rows would, so the detections do not depend on how the passes are laid
+    // out; the dropped buckets leave the rows together at the end.
     bool _detect_change() {
         bool change_detected = false;
-        bool exit_flag = false;
         tick++;
 
         if ((tick%clock == 0) && (width > grace_period)) {
-            bool reduce_width = true;
-            while (reduce_width) {
-                reduce_width = false;
-                exit_flag = false;
+            int n_flat = 0;
+            for (int idx=0;idx<n_rows;idx++) n_flat += rows.count[idx];
+            // the oldest bucket still in the window, the newest one always stays on the
+            // newer side
+            int first = 0;
+            int first_row = n_rows - 1;
+            int first_k = 0;
+            while (first < n_flat - 1) {
+                double delta_prime = std::log(2 * std::log(width) / delta);
                 int n0 = 0;
                 int n1 = width;
                 double u0 = 0.0;
                 double u1 = total;
-                double v0 = 0.0;
-                double v1 = variance;
-
-                for (int idx=bucket_deque.size()-1;idx>=0;idx--) {
-                    if (exit_flag) {
-                        break;
-                    }
-                    Bucket<max_buckets>* bucket = bucket_deque[idx];
-                    
-                    for (int k=0;k<bucket->current_idx;k++) {
-                        int n2 = _calculate_bucket_size(idx);
-                        double u2 = bucket->total_array[k];
-                        double mu2 = u2 / n2;
-                        
-                        if (n0 > 0) {
-                            double mu0 = u0 / n0;
-                            v0 += bucket->variance_array[k] + n0 * n2 * (mu0 - mu2) * (mu0 - mu2) / (n0 + n2);
-                        }
-
-                        if (n1 > 0) {
-                            double mu1 = u1 / n1;
-                            v1 += bucket->variance_array[k] + n1 * n2 * (mu1 - mu2) * (mu1 - mu2) / (n1 + n2);
-                        }
-
-                        n0 += _calculate_bucket_size(idx);
-                        n1 -= _calculate_bucket_size(idx);
-                        u0 += bucket->total_array[k];
-                        u1 -= bucket->total_array[k];
-
-                        if ((idx == 0) && (k == bucket->current_idx - 1)) {
-                            exit_flag = true;
-                            break;
-                        }
-
-                        double delta_mean = (u0 / n0) - (u1 / n1);
-                        if ((n1 >= min_window_length) && (n0 >= min_window_length) 
-                            && (_evaluate_cut(n0, n1, delta_mean, delta))) {
-                            reduce_width = true;
-                            change_detected = true;
-                            if (width > 0) {
-                                n0 -= _delete_element();
-                                exit_flag = true;
-                                break;
-                            }
-                        }
+                bool cut = false;
+                int row = first_row;
+                int k = first_k;
+                for (int j=first;j<n_flat - 1 && !cut;j++) {
+                    int n2 = _calculate_bucket_size(row);
+                    double u2 = rows.total(row, k);
+                    n0 += n2;
+                    n1 -= n2;
+                    u0 += u2;
+                    u1 -= u2;
+                    cut = _evaluate_cut(n0, n1, (u0 / n0) - (u1 / n1), delta_prime);
+                    if (++k == rows.count[row]) {
+                        row--;
+                        k = 0;
                     }
                 }
+                if (!cut) {
+                    break;
+                }
+                change_detected = true;
+                if (width == 0) {
+                    break;
+                }
+                _delete_element(_calculate_bucket_size(first_row), rows.total(first_row, first_k), 
+                    rows.variance(first_row, first_k));
+                first++;
+                if (++first_k == rows.count[first_row]) {
+                    first_row--;
+                    first_k = 0;
+                }
             }
+            _drop_oldest(first);
         }
 
         total_width += width;
@@ -212,35 +202,18 @@ public:
     AdaptiveWindowing(double delta=0.002, int clock=32, int min_window_length=5, int grace_period=10)
         : delta(delta), clock(clock), min_window_length(min_window_length), 
         grace_period(grace_period) {}
-    // move constructor
-    AdaptiveWindowing(AdaptiveWindowing&& other) : AdaptiveWindowing() { *this = std::move(other); }
-    ~AdaptiveWindowing() {
-        for (Bucket<max_buckets>* bucket : bucket_deque) {
-            if (bucket == nullptr) continue;
-            delete bucket;
-        }
-    }
-    // move assignment
-    AdaptiveWindowing& operator=(AdaptiveWindowing&& other) {
-        if (this == &other) return *this;
-        this->delta = other.delta;
-        this->clock = other.clock;
-        this->min_window_length = other.min_window_length;
-        this->grace_period = other.grace_period;
-        for (auto bucket : this->bucket_deque) {
-            if (bucket == nullptr) continue;
-            delete bucket;
-        }
-        this->bucket_deque = std::move(other.bucket_deque);
-        this->width = other.width;
-        this->total = other.total;
-        this->variance = other.variance;
-        this->total_width = other.total_width;
-        this->n_detections = other.n_detections;
-        this->tick = other.tick;
-        this->n_buckets = other.n_buckets;
-        this->max_n_buckets = other.max_n_buckets;
-        return *this;
+    // back to an empty window with the same parameters
+    void reset() {
+        rows.clear();
+        n_rows = 1;
+        total = 0.0;
+        variance = 0.0;
+        n_buckets = 0;
+        max_n_buckets = 0;
+        width = 0;
+        tick = 0;
+        total_width = 0;
+        n_detections = 0;
     }
     bool update(double value) {
         _insert_element(value, 0.0);
@@ -255,33 +228,13 @@ public:
     bool drift_detected = false;
 private:
     AdaptiveWindowing<max_buckets> _helper;
-    double delta;
-    int clock;
-    int min_window_length;
-    int grace_period;
     void _reset() {
         drift_detected = false;
-        _helper = AdaptiveWindowing<max_buckets>(delta, clock, min_window_length, grace_period);
+        _helper.reset();
     }
 public:
     ADWIN(double delta=0.002, int clock=32, int min_window_length=5, int grace_period=10)
-        : delta(delta), clock(clock), min_window_length(min_window_length), 
-        grace_period(grace_period) {
-        _reset();
-    }
-    // move constructor
-    ADWIN(ADWIN&& other) : ADWIN() { *this = std::move(other); }
-    // move assignment
-    ADWIN& operator=(ADWIN&& other) {
-        if (this == &other) return *this;
-        this->delta = other.delta;
-        this->clock = other.clock;
-        this->min_window_length = other.min_window_length;
-        this->grace_period = other.grace_period;
-        this->_helper = std::move(other._helper);
-        this->drift_detected = other.drift_detected;
-        return *this;
-    }
+        : _helper(delta, clock, min_window_length, grace_period) {}
     void update(double x) {
         if (drift_detected) {
             _reset();
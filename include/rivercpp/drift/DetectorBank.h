@@ -0,0 +1,315 @@
+# ifndef DETECTOR_BANK_H
+# define DETECTOR_BANK_H
+
+# include <algorithm>
+# include <array>
+# include <bitset>
+# include <cmath>
+# include <cstddef>
+# include <functional>
+# include <limits>
+# include <span>
+# include <vector>
+
+# include "DetectorConcept.h"
+# include "DDM.h"
+# include "HDDM_W.h"
+# include "PageHinckley.h"
+
+namespace rivercpp {
+// lanes whose flag is not 0.0, gathered 64 at a time rather than bit by bit
+template <size_t N>
+std::bitset<N> _to_mask(const std::array<double, N>& flags) {
+    std::bitset<N> mask;
+    for (size_t begin=N - (N - 1) % 64 - 1;begin<N;begin-=64) {
+        unsigned long long word = 0;
+        for (size_t i=begin;i<std::min(begin + 64, N);i++) {
+            word |= static_cast<unsigned long long>(flags[i] != 0.0) << (i - begin);
+        }
+        mask = (mask << 64) | std::bitset<N>(word);
+        if (begin == 0) break;
+    }
+    return mask;
+}
+
+// N detectors of type D updated together, lane i seeing exactly what a D fed the same
+// values would: it flags a drift on the update that detects it and starts over on its
+// next update. The generic bank keeps N separate detectors; DDM, HDDM_W and PageHinckley
+// keep every state variable as an array over the lanes and update them in one
+// branch-free loop. Their flags are stored as 0.0/1.0 so that loop touches doubles only
+// and can vectorize, the square roots in it only with -fno-math-errno. A bank is as
+// large as N of its detectors, so a bank over thousands of streams belongs on the heap.
+template <IsDetector D, size_t N>
+class DetectorBank {
+private:
+    std::function<D()> _make;
+    std::vector<D> _detectors;
+public:
+    static constexpr size_t n_detectors = N;
+    // the constructor arguments of every D
+    template <class... Args>
+    explicit DetectorBank(Args... args) : _make([=] { return D(args...); }) {
+        _detectors.reserve(N);
+        for (size_t i=0;i<N;i++) _detectors.push_back(_make());
+    }
+    // x holds one value per lane
+    std::bitset<N> update(std::span<const double> x) {
+        std::bitset<N> drifts;
+        for (size_t i=0;i<N;i++) {
+            _detectors[i].update(x[i]);
+            drifts[i] = _detectors[i].drift_detected;
+        }
+        return drifts;
+    }
+    // lanes outside active keep their state and report no drift
+    std::bitset<N> update(std::span<const double> x, const std::bitset<N>& active) {
+        std::bitset<N> drifts;
+        for (size_t i=0;i<N;i++) {
+            if (!active[i]) continue;
+            _detectors[i].update(x[i]);
+            drifts[i] = _detectors[i].drift_detected;
+        }
+        return drifts;
+    }
+    std::bitset<N> drift_mask() const {
+        std::bitset<N> drifts;
+        for (size_t i=0;i<N;i++) drifts[i] = _detectors[i].drift_detected;
+        return drifts;
+    }
+    void reset(size_t i) { _detectors[i] = _make(); }
+};
+
+template <size_t N>
+class DetectorBank<DDM, N> {
+private:
+    double drift_threshold;
+    int warm_start;
+    std::array<double, N> _n;
+    std::array<double, N> _p;
+    std::array<double, N> _ps_min;
+    std::array<double, N> _p_min;
+    std::array<double, N> _s_min;
+    std::array<double, N> _drift;
+    std::array<double, N> _active;
+    template <bool masked>
+    void _update(std::span<const double> xs) {
+        for (size_t i=0;i<N;i++) {
+            double x = xs[i];
+            bool active = !masked || _active[i] != 0.0;
+            // a lane that flagged a drift starts from the initial state
+            bool fresh = _drift[i] != 0.0;
+            double n = fresh ? 0.0 : _n[i];
+            double p = fresh ? 0.0 : _p[i];
+            double ps_min = fresh ? std::numeric_limits<double>::max() : _ps_min[i];
+            double p_min = fresh ? 0.0 : _p_min[i];
+            double s_min = fresh ? 0.0 : _s_min[i];
+
+            n += 1.0;
+            p += (1.0 / n) * (x - p);
+            double s = std::sqrt(p * (1.0 - p) / n);
+            bool warm = n > warm_start;
+            bool lower = warm & (p + s < ps_min);
+            p_min = lower ? p : p_min;
+            s_min = lower ? s : s_min;
+            ps_min = lower ? p_min + s_min : ps_min;
+            bool drift = warm & (p + s > p_min + s_min * drift_threshold);
+
+            _n[i] = active ? n : _n[i];
+            _p[i] = active ? p : _p[i];
+            _ps_min[i] = active ? ps_min : _ps_min[i];
+            _p_min[i] = active ? p_min : _p_min[i];
+            _s_min[i] = active ? s_min : _s_min[i];
+            _drift[i] = active ? (drift ? 1.0 : 0.0) : _drift[i];
+        }
+    }
+public:
+    static constexpr size_t n_detectors = N;
+    explicit DetectorBank(double drift_threshold=3.0, int warm_start=30)
+        : drift_threshold(drift_threshold), warm_start(warm_start) {
+        for (size_t i=0;i<N;i++) reset(i);
+    }
+    std::bitset<N> update(std::span<const double> x) {
+        _update<false>(x);
+        return drift_mask();
+    }
+    std::bitset<N> update(std::span<const double> x, const std::bitset<N>& active) {
+        for (size_t i=0;i<N;i++) _active[i] = active[i];
+        _update<true>(x);
+        return drift_mask() & active;
+    }
+    std::bitset<N> drift_mask() const { return _to_mask(_drift); }
+    void reset(size_t i) {
+        _n[i] = 0.0;
+        _p[i] = 0.0;
+        _ps_min[i] = std::numeric_limits<double>::max();
+        _p_min[i] = 0.0;
+        _s_min[i] = 0.0;
+        _drift[i] = 0.0;
+    }
+};
+
+template <size_t N>
+class DetectorBank<HDDM_W, N> {
+private:
+    double lambda_val;
+    double _lambd_sq;
+    double _c_lambd_sq;
+    // the McDiarmid bound is sqrt(ibc * _log_confidence / 2)
+    double _log_confidence;
+    // exponentially weighted mean and bias correction of the whole sample and of the
+    // two sides of the current cut point, an ewma of 0 means no value yet
+    std::array<double, N> _total_ewma;
+    std::array<double, N> _total_ibc;
+    std::array<double, N> _s1_ewma;
+    std::array<double, N> _s1_ibc;
+    std::array<double, N> _s1_init;
+    std::array<double, N> _s2_ewma;
+    std::array<double, N> _s2_ibc;
+    std::array<double, N> _s2_init;
+    std::array<double, N> _incr_cutpoint;
+    std::array<double, N> _drift;
+    std::array<double, N> _active;
+    double _ewma(double mean, double x) const {
+        return (mean == 0.0) ? x : lambda_val * x + (1 - lambda_val) * mean;
+    }
+    template <bool masked>
+    void _update(std::span<const double> xs) {
+        for (size_t i=0;i<N;i++) {
+            double x = xs[i];
+            bool active = !masked || _active[i] != 0.0;
+            bool fresh = _drift[i] != 0.0;
+            double total_ewma = fresh ? 0.0 : _total_ewma[i];
+            double total_ibc = fresh ? 1.0 : _total_ibc[i];
+            double s1_ewma = fresh ? 0.0 : _s1_ewma[i];
+            double s1_ibc = fresh ? 1.0 : _s1_ibc[i];
+            double s1_init = fresh ? 0.0 : _s1_init[i];
+            double s2_ewma = fresh ? 0.0 : _s2_ewma[i];
+            double s2_ibc = fresh ? 1.0 : _s2_ibc[i];
+            double s2_init = fresh ? 0.0 : _s2_init[i];
+            double incr_cutpoint = fresh ? std::numeric_limits<double>::max() : _incr_cutpoint[i];
+
+            total_ewma = _ewma(total_ewma, x);
+            total_ibc = _lambd_sq + _c_lambd_sq * total_ibc;
+            double eps = std::sqrt(total_ibc * _log_confidence / 2.0);
+            // a new lowest cut point moves the whole sample to the first side and restarts
+            // the second, otherwise the value joins the second side
+            bool cut = total_ewma + eps < incr_cutpoint;
+            incr_cutpoint = cut ? total_ewma + eps : incr_cutpoint;
+            s1_ewma = cut ? total_ewma : s1_ewma;
+            s1_ibc = cut ? total_ibc : s1_ibc;
+            s1_init = cut ? 1.0 : s1_init;
+            s2_ewma = cut ? 0.0 : _ewma(s2_ewma, x);
+            s2_ibc = cut ? 1.0 : _lambd_sq + _c_lambd_sq * s2_ibc;
+            s2_init = cut ? 0.0 : 1.0;
+            double bound = std::sqrt((s1_ibc + s2_ibc) * _log_confidence / 2.0);
+            bool drift = (s1_init * s2_init != 0.0) & (s2_ewma - s1_ewma > bound);
+
+            _total_ewma[i] = active ? total_ewma : _total_ewma[i];
+            _total_ibc[i] = active ? total_ibc : _total_ibc[i];
+            _s1_ewma[i] = active ? s1_ewma : _s1_ewma[i];
+            _s1_ibc[i] = active ? s1_ibc : _s1_ibc[i];
+            _s1_init[i] = active ? s1_init : _s1_init[i];
+            _s2_ewma[i] = active ? s2_ewma : _s2_ewma[i];
+            _s2_ibc[i] = active ? s2_ibc : _s2_ibc[i];
+            _s2_init[i] = active ? s2_init : _s2_init[i];
+            _incr_cutpoint[i] = active ? incr_cutpoint : _incr_cutpoint[i];
+            _drift[i] = active ? (drift ? 1.0 : 0.0) : _drift[i];
+        }
+    }
+public:
+    static constexpr size_t n_detectors = N;
+    explicit DetectorBank(double drift_confidence=0.001, double lambda_val=0.05)
+        : lambda_val(lambda_val),
+        _lambd_sq(lambda_val * lambda_val), _c_lambd_sq((1 - lambda_val) * (1 - lambda_val)),
+        _log_confidence(std::log(1.0 / drift_confidence)) {
+        for (size_t i=0;i<N;i++) reset(i);
+    }
+    std::bitset<N> update(std::span<const double> x) {
+        _update<false>(x);
+        return drift_mask();
+    }
+    std::bitset<N> update(std::span<const double> x, const std::bitset<N>& active) {
+        for (size_t i=0;i<N;i++) _active[i] = active[i];
+        _update<true>(x);
+        return drift_mask() & active;
+    }
+    std::bitset<N> drift_mask() const { return _to_mask(_drift); }
+    void reset(size_t i) {
+        _total_ewma[i] = 0.0;
+        _total_ibc[i] = 1.0;
+        _s1_ewma[i] = 0.0;
+        _s1_ibc[i] = 1.0;
+        _s1_init[i] = 0.0;
+        _s2_ewma[i] = 0.0;
+        _s2_ibc[i] = 1.0;
+        _s2_init[i] = 0.0;
+        _incr_cutpoint[i] = std::numeric_limits<double>::max();
+        _drift[i] = 0.0;
+    }
+};
+
+template <size_t N>
+class DetectorBank<PageHinckley, N> {
+private:
+    double threshold;
+    double delta;
+    double alpha;
+    int min_instances;
+    std::array<double, N> _n;
+    std::array<double, N> _x_mean;
+    std::array<double, N> _sum_increase;
+    std::array<double, N> _min_increase;
+    std::array<double, N> _drift;
+    std::array<double, N> _active;
+    template <bool masked>
+    void _update(std::span<const double> xs) {
+        for (size_t i=0;i<N;i++) {
+            double x = xs[i];
+            bool active = !masked || _active[i] != 0.0;
+            bool fresh = _drift[i] != 0.0;
+            double n = fresh ? 0.0 : _n[i];
+            double x_mean = fresh ? 0.0 : _x_mean[i];
+            double sum_increase = fresh ? 0.0 : _sum_increase[i];
+            double min_increase = fresh ? std::numeric_limits<double>::max() : _min_increase[i];
+
+            n += 1.0;
+            x_mean += (1.0 / n) * (x - x_mean);
+            double dev = x - x_mean;
+            sum_increase = alpha * sum_increase + dev - delta;
+            min_increase = (sum_increase < min_increase) ? sum_increase : min_increase;
+            bool drift = (n >= min_instances) & (sum_increase - min_increase > threshold);
+
+            _n[i] = active ? n : _n[i];
+            _x_mean[i] = active ? x_mean : _x_mean[i];
+            _sum_increase[i] = active ? sum_increase : _sum_increase[i];
+            _min_increase[i] = active ? min_increase : _min_increase[i];
+            _drift[i] = active ? (drift ? 1.0 : 0.0) : _drift[i];
+        }
+    }
+public:
+    static constexpr size_t n_detectors = N;
+    explicit DetectorBank(double threshold=50.0, double delta=0.005, double alpha=0.9999, int min_instances=30)
+        : threshold(threshold), delta(delta), alpha(alpha), min_instances(min_instances) {
+        for (size_t i=0;i<N;i++) reset(i);
+    }
+    std::bitset<N> update(std::span<const double> x) {
+        _update<false>(x);
+        return drift_mask();
+    }
+    std::bitset<N> update(std::span<const double> x, const std::bitset<N>& active) {
+        for (size_t i=0;i<N;i++) _active[i] = active[i];
+        _update<true>(x);
+        return drift_mask() & active;
+    }
+    std::bitset<N> drift_mask() const { return _to_mask(_drift); }
+    void reset(size_t i) {
+        _n[i] = 0.0;
+        _x_mean[i] = 0.0;
+        _sum_increase[i] = 0.0;
+        _min_increase[i] = std::numeric_limits<double>::max();
+        _drift[i] = 0.0;
+    }
+};
+}
+
+# endif
\ No newline at end of file
@@ -1,7 +1,10 @@
 # ifndef DETECTOR_CONCEPT_H
 # define DETECTOR_CONCEPT_H
 
+# include <bitset>
 # include <concepts>
+# include <cstddef>
+# include <span>
 # include <utility> // for std::move
 
 namespace rivercpp {
@@ -14,6 +17,18 @@ concept IsDetector = requires(D detector, double value) {
     requires std::movable<D>;
 };
 
+// batched counterpart of IsDetector: n_detectors lanes updated from one value each,
+// update returns the lanes that detected a drift
+template <typename B>
+concept IsDetectorBank = requires(B bank, const B const_bank, std::span<const double> x,
+    const std::bitset<B::n_detectors>& active, size_t i) {
+    { B::n_detectors } -> std::convertible_to<size_t>;
+    { bank.update(x) } -> std::same_as<std::bitset<B::n_detectors>>;
+    { bank.update(x, active) } -> std::same_as<std::bitset<B::n_detectors>>;
+    { const_bank.drift_mask() } -> std::same_as<std::bitset<B::n_detectors>>;
+    bank.reset(i);
+};
+
 template <IsDetector D, auto ... Args>
 requires IsDetector<D> && requires { D(Args...); }
 struct DetectorFactory {
@@ -4,21 +4,24 @@
 # include <cmath>
 # include <limits>
 # include <vector>
-# include <unordered_map>
+# include <array>
+# include <span>
 # include <random>
 # include <algorithm>
 # include "GaussianSplitter.h"
+# include "GaussianNBTable.h"
 
 namespace rivercpp {
-double sum(const std::unordered_map<int, double>& x) {
+template <size_t num_labels>
+double sum(const std::array<double, num_labels>& x) {
     double res = 0.0;
-    for (const auto& kv : x) {
-        res += kv.second;
+    for (size_t i=0;i<num_labels;i++) {
+        res += x[i];
     }
     return res;
 }
 
-double square_sum(const std::vector<double>& x) {
+double square_sum(std::span<const double> x) {
     double res = 0.0;
     for (const auto& v : x) {
         res += v * v;
@@ -26,42 +29,41 @@ double square_sum(const std::vector<double>& x) {
     return res;
 }
 
-double max_value(const std::unordered_map<int, double>& x) {
-    return std::max_element(x.begin(), x.end(), [](const auto& a, const auto& b) { return a.second < b.second;})->second;
+template <size_t num_labels>
+double max_value(const std::array<double, num_labels>& x) {
+    double res = x[0];
+    for (size_t i=1;i<num_labels;i++) {
+        res = x[i] > res ? x[i] : res;
+    }
+    return res;
 }
 
-double max_index(const std::vector<double>& x) {
+double max_index(std::span<const double> x) {
     return std::distance(x.begin(), std::max_element(x.begin(), x.end()));
 }
 
-int poisson(int lambda, std::default_random_engine* gen) {
-    static std::poisson_distribution<> dis(lambda);
-    return dis(*gen, std::poisson_distribution<>::param_type(lambda));
+// the distribution is local, so concurrent callers with their own generators never share state
+template <class URBG>
+int poisson(int lambda, URBG& gen) {
+    std::poisson_distribution<> dis(lambda);
+    return dis(gen);
 }
 
-template <int num_features, int num_labels>
-void do_naive_bayes_prediction(std::vector<double>& votes, const std::vector<double>& x, 
-    const std::unordered_map<int, double>& observed_class_distribution, 
-    const std::vector<GaussianSplitter<num_features, num_labels>*>& splitters){
+// add_log_likelihood(c, vote) adds the feature log-likelihoods of class c onto its log prior
+template <int num_labels, class Votes, class LogLikelihood>
+void naive_bayes_vote(Votes& votes, 
+    const std::array<double, num_labels>& observed_class_distribution, LogLikelihood&& add_log_likelihood){
     double total_weight = sum(observed_class_distribution);
     if (total_weight == 0.0) {
         return;
     }
-    for (const auto& kv : observed_class_distribution) {
-        if (kv.second > 0) {
-            votes[kv.first] = std::log(kv.second / total_weight);
-        } else {
-            votes[kv.first] = 0.0;
+    for (int c=0;c<num_labels;c++) {
+        // unseen classes keep whatever the caller put in votes
+        if (observed_class_distribution[c] <= 0.0) {
             continue;
         }
-
-        for (size_t i=0;i<splitters.size();i++) {
-            if (splitters[i] == nullptr) {
-                continue;
-            }
-            double tmp = splitters[i]->cond_proba(x[i], kv.first);
-            votes[kv.first] += tmp > 0 ? std::log(tmp) : std::numeric_limits<double>::lowest();
-        }
+        votes[c] = std::log(observed_class_distribution[c] / total_weight);
+        add_log_likelihood(c, votes[c]);
     }
 
     double max_ll = *std::max_element(votes.begin(), votes.end());
@@ -77,7 +79,19 @@ void do_naive_bayes_prediction(std::vector<double>& votes, const std::vector<dou
     }
 }
 
-void normalize_values_in_dict(std::vector<double>& res_dict, const std::unordered_map<int, double>& dictionary, 
+template <int num_features, int num_labels, class Votes>
+void do_naive_bayes_prediction(Votes& votes, std::span<const double> x, 
+    const std::array<double, num_labels>& observed_class_distribution, 
+    const GaussianNBTable<num_features, num_labels>& table){
+    std::array<double, GaussianNBTable<num_features, num_labels>::max_stride> xs;
+    table.gather(x, xs.data());
+    naive_bayes_vote<num_labels>(votes, observed_class_distribution, [&](int c, double& vote) {
+        table.add_log_likelihood(xs.data(), c, vote);
+    });
+}
+
+template <size_t num_labels, class Values>
+void normalize_values_in_dict(Values& res_dict, const std::array<double, num_labels>& dictionary, 
     double factor=0.0, bool raise_error=false){
     if (factor == 0.0) {
         factor = sum(dictionary);
@@ -85,12 +99,12 @@ void normalize_values_in_dict(std::vector<double>& res_dict, const std::unordere
     if (factor == 0.0) {
         if (raise_error)
             throw std::runtime_error("Can not normalize, normalization factor is 0");
-        for (auto& kv : dictionary) {
-            res_dict[kv.first] = kv.second;
+        for (size_t i=0;i<num_labels;i++) {
+            res_dict[i] = dictionary[i];
         }
     } else {
-        for (auto& kv : dictionary) {
-            res_dict[kv.first] = kv.second / factor;
+        for (size_t i=0;i<num_labels;i++) {
+            res_dict[i] = dictionary[i] / factor;
         }
     }
 }